@@ -10,357 +10,2580 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CL_HAVE_X86_SIMD
+#endif
 
 #include "clist.h"
 
-#define DEBUG
+#ifndef NDEBUG
+#define DEBUG
+#endif
+
+// Prefetch a node that a walk will visit next. A node's address is
+// only known once its predecessor has been loaded, so this can run
+// just one node ahead; walks that spend time on each node (freeing,
+// allocating, copying) prefetch the next node before that work, so
+// that the cache miss on it overlaps with the work. Build with
+// -DCL_NO_PREFETCH to turn this off.
+#if defined(__GNUC__) && !defined(CL_NO_PREFETCH)
+#define CL_PREFETCH(node) __builtin_prefetch((node), 0, 3)
+#else
+#define CL_PREFETCH(node) ((void) (node))
+#endif
+
+// Tracing hooks, compiled in with -DCL_TRACE; see clist_trace.h.
+// CL_TRACE_OP, at the top of a function, records an event for the
+// call when the function returns, however it returns. CL_TRACE_WALK
+// counts nodes walked by the calling thread, which the event records
+// the number of during the call; CL_TRACE_POS changes the position
+// recorded.
+#ifdef CL_TRACE
+#include "clist_trace.h"
+
+struct _cl_trace_scope {
+  CLTOp op;
+  uintptr_t list;               // taken at the start, as CL_free frees it
+  ptrdiff_t pos;
+  size_t walked;                // _CL_trace_walked at the start
+  uint64_t start_ns;
+};
+
+static _Thread_local size_t _CL_trace_walked = 0;
+
+static inline void
+_CL_trace_end(struct _cl_trace_scope *scope)
+{
+  CLT_record(scope->op, scope->list, scope->pos,
+             _CL_trace_walked - scope->walked, scope->start_ns);
+}
+
+#define CL_TRACE_OP(op, list, pos)                                      \
+  struct _cl_trace_scope _cl_trace __attribute__((cleanup(_CL_trace_end))) \
+    = { (op), (uintptr_t) (list), (pos), _CL_trace_walked, CLT_now() }
+#define CL_TRACE_WALK(n) (_CL_trace_walked += (n))
+#define CL_TRACE_POS(p) (_cl_trace.pos = (p))
+#else
+#define CL_TRACE_OP(op, list, pos) ((void) 0)
+#define CL_TRACE_WALK(n) ((void) 0)
+#define CL_TRACE_POS(p) ((void) 0)
+#endif
+
+// Links between nodes closer than this many bytes count as local
+// when measuring fragmentation
+#define CL_NEAR_BYTES 128
+
+// Minimum number of mutations between automatic fragmentation checks
+#define CL_AUTO_COMPACT_MIN 1024
+
+// Size of a cache line. List headers are allocated on whole cache
+// lines of their own, so that lists used by different threads do not
+// share one.
+#define CL_CACHE_LINE 64
+
+// CL_copy_parallel copies lists shorter than this as CL_copy does,
+// where starting threads would cost more than they save. The fuzzer
+// lowers it, to reach the parallel path on short lists.
+#ifndef CL_COPY_PARALLEL_MIN
+#define CL_COPY_PARALLEL_MIN 65536
+#endif
+
+// CL_sort_radix merge sorts chains shorter than this, and past this
+// many levels of recursion, which bounds its stack use at about 6kB
+// per level. The fuzzer lowers both, to reach every path on short
+// lists.
+#ifndef CL_RADIX_MIN
+#define CL_RADIX_MIN 32
+#endif
+#ifndef CL_RADIX_MAX_LEVELS
+#define CL_RADIX_MAX_LEVELS 32
+#endif
+
+// struct _cl_node is defined in clist.h, for CL_FOR_EACH
+
+// A chain of nodes joined onto the end of a list by CL_join, which
+// has not been linked to the chain before it yet
+struct _cl_segment {
+  struct _cl_node *head;
+  size_t length;
+  struct _cl_node **link;       // the NULL link ending the chain before,
+                                // or NULL if not known
+};
+
+// A contiguous array of nodes, allocated by CL_compact. Nodes in a
+// block are never passed to free(); the block's memory is released
+// when its last live node is. Since nodes move between lists, a
+// block is shared by every list that may hold some of its nodes.
+struct _cl_block {
+  struct _cl_node *nodes;
+  size_t count;
+  atomic_size_t live;           // nodes of the block not yet freed
+  atomic_size_t refs;           // lists referring to the block
+};
+
+struct _clist {
+  struct _cl_node *head;
+  size_t length;
+  CL_compare_fn key_cmp;        // comparator the cached keys are valid for
+  CL_key_fn key_fn;             // NULL if keys are not cached
+  struct _cl_block **blocks;    // blocks this list may hold nodes of,
+  int num_blocks;               // in address order
+  int max_blocks;               // allocated size of blocks
+  size_t churn;                 // mutations since the last auto compaction
+  double auto_compact;          // fragmentation that triggers CL_compact
+  struct _cl_segment *segments; // chains after head's, in list order
+  int num_segments;
+  int max_segments;             // allocated size of segments
+  size_t segment_length;        // elements on the segments
+  struct _cl_node **finger;     // link to the node at finger_pos, or NULL
+  size_t finger_pos;            // position last reached by CL_nth etc.
+  struct _cl_node **tail;       // the NULL link ending the last chain,
+                                // or NULL if not known
+};
+
+
+
+static void _CL_note_churn(CList list);
+
+
+
+/*
+ * Create (malloc) a new _cl_node and populate it with the supplied
+ * values. If the list caches keys, the key for element is computed.
+ *
+ * Parameters:
+ *   list           the list the node will be linked into
+ *   element, next  the values for the node to be created
+ * 
+ * Returns: The newly-malloc'd node, or NULL in case of error
+ */
+static struct _cl_node*
+_CL_new_node(CList list, CListElementType element, struct _cl_node *next)
+{
+  struct _cl_node* new = (struct _cl_node*) malloc(sizeof(struct _cl_node));
+
+  assert(new);
+
+  new->element = element;
+  new->next = next;
+  new->key = list->key_fn ? list->key_fn(element) : 0;
+
+  return new;
+}
+
+
+
+/*
+ * Convert a position to int for the int-based functions, saturating
+ * at INT_MAX for positions on lists longer than INT_MAX elements
+ */
+static inline int
+_CL_int_pos(size_t pos)
+{
+  return (pos > INT_MAX) ? INT_MAX : (int) pos;
+}
+
+
+
+// The address just past a block's nodes
+static inline uintptr_t
+_CL_block_end(struct _cl_block *block)
+{
+  return (uintptr_t) block->nodes + block->count * sizeof(struct _cl_node);
+}
+
+
+
+/*
+ * Find where an address falls among the list's blocks, which are kept
+ * sorted by address and do not overlap
+ *
+ * Returns: The index of the last block starting at or before addr, or
+ *   -1 if there is none
+ */
+static int
+_CL_block_before(CList list, uintptr_t addr)
+{
+  int lo = 0;
+  int hi = list->num_blocks;
+
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if ((uintptr_t) list->blocks[mid]->nodes <= addr)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo - 1;
+}
+
+
+
+/*
+ * Remove the reference from list to its i'th block, freeing the block
+ * descriptor if no list refers to it any more
+ *
+ * Returns: None
+ */
+static void
+_CL_drop_block(CList list, int i)
+{
+  struct _cl_block *block = list->blocks[i];
+
+  list->num_blocks--;
+  memmove(&list->blocks[i], &list->blocks[i + 1],
+          (list->num_blocks - i) * sizeof(*list->blocks));
+  if (atomic_fetch_sub(&block->refs, 1) == 1)
+    free(block);
+}
+
+
+
+/*
+ * Add a reference from list to block, keeping the list's blocks in
+ * address order
+ *
+ * Returns: None
+ */
+static void
+_CL_add_block(CList list, struct _cl_block *block)
+{
+  if (atomic_load(&block->live) == 0)
+    return;  // Its memory is released, so no node can be in it
+
+  uintptr_t start = (uintptr_t) block->nodes;
+  uintptr_t end = _CL_block_end(block);
+  int i = _CL_block_before(list, start);
+  if (i >= 0 && list->blocks[i] == block)
+    return;  // Already referenced
+
+  // A live block can only overlap one that has released its memory,
+  // which the new block was then given; forget the old one, so that
+  // the blocks stay apart
+  if (i >= 0 && _CL_block_end(list->blocks[i]) > start)
+    _CL_drop_block(list, i--);
+  while (i + 1 < list->num_blocks
+         && (uintptr_t) list->blocks[i + 1]->nodes < end)
+    _CL_drop_block(list, i + 1);
+
+  if (list->num_blocks == list->max_blocks) {
+    list->max_blocks = list->max_blocks ? 2 * list->max_blocks : 4;
+    list->blocks = (struct _cl_block **)
+      realloc(list->blocks, list->max_blocks * sizeof(*list->blocks));
+    assert(list->blocks);
+  }
+  memmove(&list->blocks[i + 2], &list->blocks[i + 1],
+          (list->num_blocks - i - 1) * sizeof(*list->blocks));
+  list->blocks[i + 1] = block;
+  list->num_blocks++;
+  atomic_fetch_add(&block->refs, 1);
+}
+
+
+
+/*
+ * Release a node that has been unlinked from list: free() it, or, if
+ * it lives in one of the list's blocks, count it out of the block.
+ * The block is found by binary search, so this takes time logarithmic
+ * in the number of blocks.
+ *
+ * Parameters:
+ *   list     The list the node was on
+ *   node     The node
+ *
+ * Returns: None
+ */
+static void
+_CL_free_node(CList list, struct _cl_node *node)
+{
+  uintptr_t addr = (uintptr_t) node;
+  int i = _CL_block_before(list, addr);
+
+  if (i >= 0 && addr < _CL_block_end(list->blocks[i])) {
+    struct _cl_block *block = list->blocks[i];
+
+    // A block with no live nodes has released its memory, which the
+    // node has since been given
+    if (atomic_load(&block->live) == 0) {
+      _CL_drop_block(list, i);
+    } else {
+      if (atomic_fetch_sub(&block->live, 1) == 1) {
+        free(block->nodes);
+        _CL_drop_block(list, i);
+      }
+      return;
+    }
+  }
+
+  free(node);
+}
+
+
+
+/*
+ * Release a NULL-terminated chain of nodes that has been unlinked
+ * from list, as _CL_free_node does for each of them
+ *
+ * Returns: None
+ */
+static void
+_CL_free_chain(CList list, struct _cl_node *node)
+{
+  while (node != NULL) {
+    struct _cl_node *next = node->next;
+    CL_PREFETCH(next);  // Load it while free() works on this one
+    _CL_free_node(list, node);
+    node = next;
+  }
+}
+
+
+
+/*
+ * Prepare dst to take over a chain of nodes from src: recompute the
+ * cached keys of the chain if the two lists do not cache the same
+ * keys, and let dst refer to the blocks the nodes may live in.
+ *
+ * Parameters:
+ *   dst      The list receiving the nodes
+ *   src      The list the nodes came from
+ *   node     The first node of the chain
+ *
+ * Returns: None
+ */
+static void
+_CL_adopt_nodes(CList dst, CList src, struct _cl_node *node)
+{
+  for (int i = 0; i < src->num_blocks; i++)
+    _CL_add_block(dst, src->blocks[i]);
+
+  if (dst->key_fn == NULL || dst->key_fn == src->key_fn)
+    return;
+
+  for (; node != NULL; node = node->next)
+    node->key = dst->key_fn(node->element);
+}
+
+
+
+/*
+ * Record a chain of nodes as the new last segment of a list, without
+ * walking it. The list's length is not updated.
+ *
+ * Parameters:
+ *   list     The list
+ *   head     The first node of the chain
+ *   length   The number of nodes on the chain
+ *   link     The NULL link ending the list's last chain, which the
+ *            segment will be linked to; NULL if not known
+ *
+ * Returns: None
+ */
+static void
+_CL_add_segment(CList list, struct _cl_node *head, size_t length,
+                struct _cl_node **link)
+{
+  if (list->length == 0) {
+    list->head = head;  // Nothing to link it to
+    return;
+  }
+
+  if (list->num_segments == list->max_segments) {
+    list->max_segments = list->max_segments ? 2 * list->max_segments : 8;
+    list->segments = (struct _cl_segment *)
+      realloc(list->segments, list->max_segments * sizeof(*list->segments));
+    assert(list->segments);
+  }
+  list->segments[list->num_segments].head = head;
+  list->segments[list->num_segments].length = length;
+  list->segments[list->num_segments].link = link;
+  list->num_segments++;
+  list->segment_length += length;
+}
+
+
+
+/*
+ * Link the segments recorded by CL_join onto the end of the list's
+ * first chain, so that every node is reachable from list->head. Every
+ * function that changes links or relies on them being complete calls
+ * this first. Each segment records the link ending the chain before
+ * it, so this takes time in the number of segments; only a chain
+ * whose end was not known when the segment was recorded is walked.
+ *
+ * Returns: None
+ */
+static void
+_CL_link_segments(CList list)
+{
+  if (list->num_segments == 0) return;
+
+  for (int i = 0; i < list->num_segments; i++) {
+    struct _cl_node **tracer = list->segments[i].link;
+    if (tracer == NULL) {
+      tracer = (i == 0) ? &list->head : &list->segments[i - 1].head;
+      while (*tracer != NULL)
+        tracer = &((*tracer)->next);
+    }
+    assert(*tracer == NULL);
+    *tracer = list->segments[i].head;
+  }
+  list->num_segments = 0;
+  list->segment_length = 0;
+}
+
+
+
+/*
+ * Find the first node of a list, for a walk that steps across the
+ * segments recorded by CL_join with _CL_next_node
+ *
+ * Parameters:
+ *   list     The list
+ *   chain    Set to the number of segments the walk has entered
+ *
+ * Returns: The first node, or NULL if the list is empty
+ */
+static inline struct _cl_node *
+_CL_first_node(CList list, int *chain)
+{
+  struct _cl_node *node = list->head;
+
+  *chain = 0;
+  while (node == NULL && *chain < list->num_segments)
+    node = list->segments[(*chain)++].head;
+  return node;
+}
+
+
+
+/*
+ * Step from a node to the next one of the list, moving on to the
+ * next segment at the end of a chain
+ *
+ * Parameters:
+ *   list     The list
+ *   node     The current node
+ *   chain    The number of segments the walk has entered; updated
+ *
+ * Returns: The next node, or NULL after the last one
+ */
+static inline struct _cl_node *
+_CL_next_node(CList list, struct _cl_node *node, int *chain)
+{
+  struct _cl_node *next = node->next;
+
+  while (next == NULL && *chain < list->num_segments)
+    next = list->segments[(*chain)++].head;
+  return next;
+}
+
+
+
+/*
+ * Forget the list's finger and tail. Functions that reorder, free or
+ * move nodes other than at a known position call this, since the
+ * link the finger points to may no longer lead to finger_pos, the
+ * link the tail points to may no longer end the list, and either may
+ * no longer be in a node of the list.
+ *
+ * Returns: None
+ */
+static inline void
+_CL_drop_hints(CList list)
+{
+  list->finger = NULL;
+  list->tail = NULL;
+}
+
+
+
+/*
+ * Find the link (head pointer or next field) that points to the node
+ * at a position of a list, as _CL_link_at does, but starting from the
+ * finger if it is at or before the position, and leave the finger on
+ * the link found. Walking a list in order by position thus takes
+ * amortized constant time per step, and since the finger is a link,
+ * a node can be inserted or removed at its position without a walk.
+ * The list's segments must have been linked.
+ *
+ * Parameters:
+ *   list     The list
+ *   pos      The position, in the range [0, length]
+ *
+ * Returns: The link; *link is NULL if pos == length
+ */
+static struct _cl_node **
+_CL_finger_link(CList list, size_t pos)
+{
+  struct _cl_node **tracer = &list->head;
+  size_t i = 0;
+
+  if (list->finger != NULL && list->finger_pos <= pos) {
+    tracer = list->finger;
+    i = list->finger_pos;
+  }
+  CL_TRACE_WALK(pos - i);
+  for (; i < pos; i++)
+    tracer = &((*tracer)->next);
+
+  list->finger = tracer;
+  list->finger_pos = pos;
+  return tracer;
+}
+
+
+
+/*
+ * String comparison kernels for CL_strcmp. The vector kernels load 16
+ * or 32 bytes of each string at a time, which may read past the
+ * terminating NUL, but never across a page boundary: within a page,
+ * the bytes are readable even if they belong to another object.
+ * Near the end of a page they step one byte at a time instead. The
+ * over-reads are deliberate, so they are hidden from AddressSanitizer.
+ *
+ * Returns: <0, 0, or >0 as for strcmp
+ */
+static int
+_CL_strcmp_scalar(const char *a, const char *b)
+{
+  const unsigned char *s1 = (const unsigned char *) a;
+  const unsigned char *s2 = (const unsigned char *) b;
+
+  while (*s1 != '\0' && *s1 == *s2) {
+    s1++;
+    s2++;
+  }
+  return *s1 - *s2;
+}
+
+#ifdef CL_HAVE_X86_SIMD
+
+#define CL_PAGE_SIZE 4096
+
+// True if a load of width bytes at p might cross into the next page
+#define CL_NEAR_PAGE_END(p, width) \
+  (((uintptr_t) (p) & (CL_PAGE_SIZE - 1)) > CL_PAGE_SIZE - (width))
+
+__attribute__((no_sanitize_address))
+static int
+_CL_strcmp_sse2(const char *a, const char *b)
+{
+  const unsigned char *s1 = (const unsigned char *) a;
+  const unsigned char *s2 = (const unsigned char *) b;
+  const __m128i zero = _mm_setzero_si128();
+
+  for (;;) {
+    if (CL_NEAR_PAGE_END(s1, 16) || CL_NEAR_PAGE_END(s2, 16)) {
+      if (*s1 != *s2 || *s1 == '\0')
+        return *s1 - *s2;
+      s1++;
+      s2++;
+      continue;
+    }
+
+    __m128i v1 = _mm_loadu_si128((const __m128i *) s1);
+    __m128i v2 = _mm_loadu_si128((const __m128i *) s2);
+    // Bytes that differ, or where s1 ends
+    unsigned mask = (~_mm_movemask_epi8(_mm_cmpeq_epi8(v1, v2))
+                     | _mm_movemask_epi8(_mm_cmpeq_epi8(v1, zero))) & 0xffff;
+    if (mask != 0) {
+      int i = __builtin_ctz(mask);
+      return s1[i] - s2[i];
+    }
+    s1 += 16;
+    s2 += 16;
+  }
+}
+
+__attribute__((no_sanitize_address, target("avx2")))
+static int
+_CL_strcmp_avx2(const char *a, const char *b)
+{
+  const unsigned char *s1 = (const unsigned char *) a;
+  const unsigned char *s2 = (const unsigned char *) b;
+  const __m256i zero = _mm256_setzero_si256();
+
+  for (;;) {
+    if (CL_NEAR_PAGE_END(s1, 32) || CL_NEAR_PAGE_END(s2, 32)) {
+      if (*s1 != *s2 || *s1 == '\0')
+        return *s1 - *s2;
+      s1++;
+      s2++;
+      continue;
+    }
+
+    __m256i v1 = _mm256_loadu_si256((const __m256i *) s1);
+    __m256i v2 = _mm256_loadu_si256((const __m256i *) s2);
+    // Bytes that differ, or where s1 ends
+    unsigned mask = ~(unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v1, v2))
+      | (unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v1, zero));
+    if (mask != 0) {
+      int i = __builtin_ctz(mask);
+      return s1[i] - s2[i];
+    }
+    s1 += 32;
+    s2 += 32;
+  }
+}
+
+#endif // CL_HAVE_X86_SIMD
+
+typedef int (*_CL_strcmp_kernel)(const char *a, const char *b);
+
+static int _CL_strcmp_resolve(const char *a, const char *b);
+
+// The kernel CL_strcmp uses, chosen on the first call
+static _Atomic(_CL_strcmp_kernel) _CL_strcmp_impl = _CL_strcmp_resolve;
+
+
+
+/*
+ * Choose the fastest kernel the CPU supports, then compare a and b
+ * with it
+ *
+ * Returns: <0, 0, or >0 as for strcmp
+ */
+static int
+_CL_strcmp_resolve(const char *a, const char *b)
+{
+  _CL_strcmp_kernel kernel = _CL_strcmp_scalar;
+
+#ifdef CL_HAVE_X86_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    kernel = _CL_strcmp_avx2;
+  else if (__builtin_cpu_supports("sse2"))
+    kernel = _CL_strcmp_sse2;
+#endif
+
+  atomic_store_explicit(&_CL_strcmp_impl, kernel, memory_order_relaxed);
+  return kernel(a, b);
+}
+
+
+
+// Documented in .h file
+int CL_strcmp(const char *a, const char *b) {
+  return atomic_load_explicit(&_CL_strcmp_impl, memory_order_relaxed)(a, b);
+}
+
+
+
+/*
+ * Returns the comparator that cmp is equivalent to, so that keys
+ * cached for strcmp are used by operations that call CL_strcmp, and
+ * the other way around
+ */
+static inline CL_compare_fn
+_CL_canonical_cmp(CL_compare_fn cmp)
+{
+  return (cmp == strcmp) ? CL_strcmp : cmp;
+}
+
+
+
+// How a sorted operation may use the keys cached in nodes
+enum {
+  CL_KEYS_NONE = 0,     // Keys are not valid for the comparator in use
+  CL_KEYS_CACHED,       // Keys are valid: compare them first
+  CL_KEYS_PREFIX,       // Keys are CL_key_prefix for strcmp, so equal
+                        // keys also mean equal first 8 bytes
+};
+
+
+
+/*
+ * Returns how the keys cached in list may be used for comparisons
+ * made with cmp, as one of the CL_KEYS_ values
+ */
+static inline int
+_CL_keyed(CList list, CL_compare_fn cmp)
+{
+  if (list->key_fn == NULL || list->key_cmp != _CL_canonical_cmp(cmp))
+    return CL_KEYS_NONE;
+  if (list->key_cmp == CL_strcmp && list->key_fn == CL_key_prefix)
+    return CL_KEYS_PREFIX;
+  return CL_KEYS_CACHED;
+}
+
+
+
+/*
+ * Compare two elements, consulting their cached keys first as allowed
+ * by keyed, one of the CL_KEYS_ values.
+ *
+ * Returns: <0, 0, or >0 as for strcmp
+ */
+static inline int
+_CL_compare(CL_compare_fn cmp, int keyed,
+            CListElementType a, uint64_t key_a,
+            CListElementType b, uint64_t key_b)
+{
+  if (keyed != CL_KEYS_NONE) {
+    if (key_a != key_b)
+      return (key_a < key_b) ? -1 : 1;
+
+    // Equal prefix keys: either both strings are shorter than 8 bytes
+    // and therefore equal, or only the rest needs comparing
+    if (keyed == CL_KEYS_PREFIX)
+      return ((key_a & 0xff) == 0) ? 0 : CL_strcmp(a + 8, b + 8);
+  }
+
+  return cmp(a, b);
+}
+
+
+
+/*
+ * Merge two sorted chains of nodes into one, taking from a first
+ * where elements compare equal.
+ *
+ * Returns: The head of the merged chain
+ */
+static struct _cl_node *
+_CL_merge_nodes(struct _cl_node *a, struct _cl_node *b,
+                CL_compare_fn cmp, int keyed)
+{
+  struct _cl_node *head = NULL;
+  struct _cl_node **tracer = &head;
+
+  while (a != NULL && b != NULL) {
+    if (_CL_compare(cmp, keyed, b->element, b->key, a->element, a->key) < 0) {
+      *tracer = b;
+      b = b->next;
+    } else {
+      *tracer = a;
+      a = a->next;
+    }
+    tracer = &((*tracer)->next);
+  }
+  *tracer = (a != NULL) ? a : b;
+
+  return head;
+}
+
+
+
+/*
+ * Sort a NULL-terminated chain of nodes, stably, with a bottom-up
+ * merge sort: bins[i] holds a sorted run of 2^i nodes, and each node
+ * carries into the bins like a binary counter. Runs in higher bins
+ * always hold earlier nodes, which keeps the sort stable.
+ *
+ * Returns: The head of the sorted chain
+ */
+static struct _cl_node *
+_CL_sort_nodes(struct _cl_node *node, CL_compare_fn cmp, int keyed)
+{
+  struct _cl_node *bins[64] = { NULL };
+
+  while (node != NULL) {
+    struct _cl_node *carry = node;
+    node = node->next;
+    carry->next = NULL;
+
+    int i;
+    for (i = 0; bins[i] != NULL; i++) {
+      carry = _CL_merge_nodes(bins[i], carry, cmp, keyed);
+      bins[i] = NULL;
+    }
+    bins[i] = carry;
+  }
+
+  struct _cl_node *sorted = NULL;
+  for (int i = 0; i < 64; i++)
+    if (bins[i] != NULL)
+      sorted = _CL_merge_nodes(bins[i], sorted, cmp, keyed);
+
+  return sorted;
+}
+
+
+
+// Key offset for _CL_radix_nodes when the keys do not hold a prefix
+#define CL_RADIX_NO_KEYS SIZE_MAX
+
+/*
+ * Return true if a node's key holds the byte of its element at depth,
+ * given that it holds the 8 bytes from offset key_depth
+ */
+static inline bool
+_CL_radix_in_key(size_t depth, size_t key_depth)
+{
+  return key_depth != CL_RADIX_NO_KEYS && depth >= key_depth
+    && depth - key_depth < 8;
+}
+
+
+
+/*
+ * Return the byte of a node's element at an offset, for
+ * _CL_radix_nodes: from the node's key if it holds the byte, which
+ * saves loading the string. The element must be at least depth bytes
+ * long.
+ */
+static inline unsigned char
+_CL_radix_byte(struct _cl_node *node, size_t depth, size_t key_depth)
+{
+  if (_CL_radix_in_key(depth, key_depth))
+    return (node->key >> (56 - 8 * (depth - key_depth))) & 0xff;
+  return (unsigned char) node->element[depth];
+}
+
+
+
+/*
+ * Find how far the elements of a chain share a prefix, in one walk,
+ * so that _CL_radix_nodes need not spend a walk on every shared byte
+ *
+ * Parameters:
+ *   node       The first node of the chain
+ *   depth      The length of a prefix the elements are known to share
+ *   key_depth  As for _CL_radix_nodes
+ *
+ * Returns: The offset of the first byte at which two elements differ
+ *   or the first element ends
+ */
+static size_t
+_CL_radix_prefix(struct _cl_node *node, size_t depth, size_t key_depth)
+{
+  if (_CL_radix_in_key(depth, key_depth)) {
+    uint64_t first = node->key;
+    uint64_t diff = 0;
+    for (struct _cl_node *n = node; n != NULL; n = n->next)
+      diff |= n->key ^ first;
+    for (; depth - key_depth < 8; depth++) {
+      int shift = 56 - 8 * (int) (depth - key_depth);
+      if (((diff >> shift) & 0xff) != 0 || ((first >> shift) & 0xff) == 0)
+        return depth;
+    }
+  }
+
+  const char *first = node->element;
+  size_t shared = SIZE_MAX;
+  for (struct _cl_node *n = node; n != NULL; n = n->next) {
+    size_t i = depth;
+    while (i < shared && first[i] != '\0' && n->element[i] == first[i])
+      i++;
+    shared = i;
+  }
+  return shared;
+}
+
+
+
+/*
+ * MSD radix sort of a NULL-terminated chain of nodes by the bytes of
+ * their elements from offset depth on; every element is known to
+ * share its first depth bytes with the others. The nodes are dealt
+ * into 256 buckets by their byte at depth, in order, which keeps the
+ * sort stable, and the buckets are sorted in turn and concatenated.
+ * Bucket 0 holds elements that end at depth, which are all equal.
+ * Chains shorter than CL_RADIX_MIN, or past CL_RADIX_MAX_LEVELS levels
+ * of recursion, are merge sorted instead.
+ *
+ * Bytes are read from the nodes' keys where they can be, since the
+ * keys are in the nodes and the strings are elsewhere. If the sort
+ * owns the keys, a pass that has to load the strings anyway stores
+ * the next 8 bytes of each element in its key.
+ *
+ * Parameters:
+ *   node       The first node of the chain
+ *   count      The number of nodes on the chain
+ *   depth      The offset of the byte to sort by
+ *   level      The recursion depth
+ *   keyed      How the list's keys may be used for CL_strcmp
+ *   own        If true, the list does not cache keys, so the sort
+ *              may overwrite them
+ *   key_depth  The keys hold CL_key_prefix(element + key_depth), or
+ *              CL_RADIX_NO_KEYS if they do not hold a prefix
+ *   tail       Set to the last node of the sorted chain
+ *
+ * Returns: The head of the sorted chain
+ */
+static struct _cl_node *
+_CL_radix_nodes(struct _cl_node *node, size_t count, size_t depth, int level,
+                int keyed, bool own, size_t key_depth, struct _cl_node **tail)
+{
+  struct _cl_node *heads[256];
+  struct _cl_node *tails[256];
+  size_t counts[256];
+
+  for (;;) {
+    if (count < CL_RADIX_MIN || level >= CL_RADIX_MAX_LEVELS) {
+      // Keys taken from further into the elements still order them,
+      // as the elements share the bytes before
+      if (own)
+        keyed = (key_depth == 0) ? CL_KEYS_PREFIX
+          : (key_depth == CL_RADIX_NO_KEYS) ? CL_KEYS_NONE : CL_KEYS_CACHED;
+      struct _cl_node *head = _CL_sort_nodes(node, CL_strcmp, keyed);
+      for (*tail = head; (*tail)->next != NULL; *tail = (*tail)->next)
+        ;
+      return head;
+    }
+
+    bool refill = own && !_CL_radix_in_key(depth, key_depth);
+    if (refill)
+      key_depth = depth;
+
+    memset(counts, 0, sizeof(counts));
+    int last = 0;
+    for (; node != NULL; node = node->next) {
+      if (refill)
+        node->key = CL_key_prefix(node->element + depth);
+      unsigned char b = _CL_radix_byte(node, depth, key_depth);
+      if (counts[b]++ == 0)
+        heads[b] = node;
+      else
+        tails[b]->next = node;
+      tails[b] = node;
+      last = b;
+    }
+
+    // A byte shared by every element: skip to the first byte that is
+    // not, without recursing
+    if (last != 0 && counts[last] == count) {
+      tails[last]->next = NULL;
+      node = heads[last];
+      depth = _CL_radix_prefix(node, depth + 1, key_depth);
+      continue;
+    }
+    break;
+  }
+
+  struct _cl_node *head = NULL;
+  struct _cl_node **tracer = &head;
+  for (int b = 0; b < 256; b++) {
+    if (counts[b] == 0) continue;
+
+    tails[b]->next = NULL;
+    if (b == 0) {
+      *tracer = heads[0];  // Equal elements, already in order
+      *tail = tails[0];
+    } else {
+      *tracer = _CL_radix_nodes(heads[b], counts[b], depth + 1, level + 1,
+                                keyed, own, key_depth, tail);
+    }
+    tracer = &(*tail)->next;
+  }
+
+  return head;
+}
+
+
+
+// Documented in .h file
+CList CL_new()
+{
+  size_t size = (sizeof(struct _clist) + CL_CACHE_LINE - 1)
+    / CL_CACHE_LINE * CL_CACHE_LINE;
+  CList list = (CList) aligned_alloc(CL_CACHE_LINE, size);
+  assert(list);
+
+  list->head = NULL;
+  list->length = 0;
+  list->key_cmp = NULL;
+  list->key_fn = NULL;
+  list->blocks = NULL;
+  list->num_blocks = 0;
+  list->max_blocks = 0;
+  list->churn = 0;
+  list->auto_compact = 0.0;
+  list->segments = NULL;
+  list->num_segments = 0;
+  list->max_segments = 0;
+  list->segment_length = 0;
+  list->finger = NULL;
+  list->finger_pos = 0;
+  list->tail = &list->head;
+
+  return list;
+}
+
+
+
+// Documented in .h file
+void CL_free(CList list) {
+    if (list == NULL) return; // Check if list is NULL to prevent accessing invalid memory
+    CL_TRACE_OP(CLT_OP_FREE, list, -1);
+    CL_TRACE_WALK(list->length);
+
+    int chain;
+    struct _cl_node *current = _CL_first_node(list, &chain); // Segments need no linking first
+    while (current != NULL) {
+        struct _cl_node *next = _CL_next_node(list, current, &chain); // Save the next node
+        CL_PREFETCH(next); // Load it while free() works on this one
+        _CL_free_node(list, current); // Free the current node
+        current = next; // Move to the next node
+    }
+    while (list->num_blocks > 0)
+        _CL_drop_block(list, list->num_blocks - 1); // Drop references to emptied blocks
+    free(list->blocks);
+    free(list->segments);
+    free(list); // Finally, free the list structure itself
+}
+
+
+
+
+// A list waiting for the reclaimer thread to free it
+struct _cl_doomed {
+  CList list;
+  struct _cl_doomed *next;
+};
+
+// The reclaimer thread's queue, and the number of lists queued or
+// being freed, all guarded by _CL_reclaim_lock
+static pthread_mutex_t _CL_reclaim_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t _CL_reclaim_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t _CL_reclaim_done = PTHREAD_COND_INITIALIZER;
+static struct _cl_doomed *_CL_reclaim_queue = NULL;
+static size_t _CL_reclaim_pending = 0;
+
+static pthread_once_t _CL_reclaim_once = PTHREAD_ONCE_INIT;
+static bool _CL_reclaim_started = false;
+
+
+
+/*
+ * The reclaimer thread: takes the whole queue at a time and frees the
+ * lists on it, in the order they were queued
+ *
+ * Returns: Never
+ */
+static void *
+_CL_reclaimer(void *arg)
+{
+  (void) arg;
+
+  for (;;) {
+    pthread_mutex_lock(&_CL_reclaim_lock);
+    while (_CL_reclaim_queue == NULL)
+      pthread_cond_wait(&_CL_reclaim_work, &_CL_reclaim_lock);
+    struct _cl_doomed *doomed = _CL_reclaim_queue;
+    _CL_reclaim_queue = NULL;
+    pthread_mutex_unlock(&_CL_reclaim_lock);
+
+    // The queue is pushed onto at the front, so reverse it
+    struct _cl_doomed *ordered = NULL;
+    while (doomed != NULL) {
+      struct _cl_doomed *next = doomed->next;
+      doomed->next = ordered;
+      ordered = doomed;
+      doomed = next;
+    }
+
+    size_t freed = 0;
+    while (ordered != NULL) {
+      struct _cl_doomed *next = ordered->next;
+      CL_free(ordered->list);
+      free(ordered);
+      ordered = next;
+      freed++;
+    }
+
+    pthread_mutex_lock(&_CL_reclaim_lock);
+    _CL_reclaim_pending -= freed;
+    if (_CL_reclaim_pending == 0)
+      pthread_cond_broadcast(&_CL_reclaim_done);
+    pthread_mutex_unlock(&_CL_reclaim_lock);
+  }
+  return NULL;
+}
+
+
+
+// Start the reclaimer thread, once; it runs until the process exits
+static void
+_CL_start_reclaimer()
+{
+  pthread_t thread;
+
+  if (pthread_create(&thread, NULL, _CL_reclaimer, NULL) == 0) {
+    pthread_detach(thread);
+    _CL_reclaim_started = true;
+  }
+}
+
+
+
+// Documented in .h file
+void CL_free_deferred(CList list) {
+  if (list == NULL) return;
+
+  pthread_once(&_CL_reclaim_once, _CL_start_reclaimer);
+  if (!_CL_reclaim_started) {
+    CL_free(list);  // No thread to hand it to
+    return;
+  }
+
+  struct _cl_doomed *doomed = (struct _cl_doomed *) malloc(sizeof(*doomed));
+  assert(doomed);
+  doomed->list = list;
+
+  pthread_mutex_lock(&_CL_reclaim_lock);
+  doomed->next = _CL_reclaim_queue;
+  _CL_reclaim_queue = doomed;
+  _CL_reclaim_pending++;
+  pthread_cond_signal(&_CL_reclaim_work);
+  pthread_mutex_unlock(&_CL_reclaim_lock);
+}
+
+
+
+// Documented in .h file
+void CL_free_wait() {
+  pthread_mutex_lock(&_CL_reclaim_lock);
+  while (_CL_reclaim_pending > 0)
+    pthread_cond_wait(&_CL_reclaim_done, &_CL_reclaim_lock);
+  pthread_mutex_unlock(&_CL_reclaim_lock);
+}
+
+
+
+
+
+// Documented in .h file
+int CL_length(CList list)
+{
+  return _CL_int_pos(CL_length_z(list));
+}
+
+
+
+// Documented in .h file
+size_t CL_length_z(CList list)
+{
+  assert(list);
+#ifdef DEBUG
+  // In production code, we simply return the stored value for
+  // length. However, as a defensive programming method to prevent
+  // bugs in our code, in DEBUG mode we walk the list and ensure the
+  // number of elements on the list is equal to the stored length.
+
+  size_t len = 0;
+  int chain;
+  struct _cl_node **end = &list->head;
+  for (struct _cl_node *node = _CL_first_node(list, &chain); node != NULL;
+       node = _CL_next_node(list, node, &chain)) {
+    len++;
+    end = &node->next;
+  }
+
+  assert(len == list->length);
+  assert(list->tail == NULL || list->tail == end);
+#endif // DEBUG
+
+  return list->length;
+}
+
+
+
+// Documented in .h file
+void CL_print(CList list)
+{
+  assert(list);
+
+  size_t num = 0;
+  int chain;
+  for (struct _cl_node *node = _CL_first_node(list, &chain); node != NULL;
+       node = _CL_next_node(list, node, &chain))
+    printf("  [%zu]: %s\n", num++, node->element);
+}
+
+
+
+// Documented in .h file
+void CL_push(CList list, CListElementType element)
+{
+  assert(list);
+  CL_TRACE_OP(CLT_OP_PUSH, list, 0);
+  list->head = _CL_new_node(list, element, list->head);
+  list->length++;
+  if (list->head->next == NULL && list->num_segments)
+    list->segments[0].link = &list->head->next;  // The first chain was empty
+  if (list->finger != &list->head)
+    list->finger_pos++;  // The finger's node moved up one place
+  if (list->tail == &list->head)
+    list->tail = &list->head->next;  // The list was empty
+  _CL_note_churn(list);
+}
+
+
+
+// Documented in .h file
+CListElementType CL_pop(CList list)
+{
+  assert(list);
+  CL_TRACE_OP(CLT_OP_POP, list, 0);
+
+  if (list->head == NULL)
+    _CL_link_segments(list);  // The first chain has been popped empty
+
+  struct _cl_node *popped_node = list->head;
+
+  if (popped_node == NULL)
+    return INVALID_RETURN;
+
+  CListElementType ret = popped_node->element;
+
+  list->head = popped_node->next;
+  if (list->head == NULL && list->num_segments)
+    list->segments[0].link = &list->head;  // The first chain is now empty
+  if (list->tail == &popped_node->next)
+    list->tail = &list->head;  // It was the only node
+  _CL_free_node(list, popped_node);
+  if (list->finger != NULL && list->finger != &list->head) {
+    if (--list->finger_pos == 0)
+      list->finger = &list->head;  // It was in the popped node
+  }
+
+  list->length--;
+  _CL_note_churn(list);
+
+  return ret;
+}
+
+
+
+// Documented in .h file
+void CL_append(CList list, CListElementType element)
+{
+    assert(list);  // Ensure the list is valid
+    CL_TRACE_OP(CLT_OP_APPEND, list, list->length);
+
+    struct _cl_node *new_node = _CL_new_node(list, element, NULL);  // Create new node with no next node
+    assert(new_node);  // Ensure the node was created successfully
+
+    if (list->head == NULL)
+        _CL_link_segments(list);  // The first chain has been popped empty
+
+    if (list->num_segments) {
+        list->segments[list->num_segments - 1].length++;  // The last chain grows
+        list->segment_length++;
+    }
+
+    if (list->tail == NULL) {
+        // The end is not known, so traverse to the end of the last chain
+        list->tail = list->num_segments
+            ? &list->segments[list->num_segments - 1].head : &list->head;
+        while (*list->tail != NULL) {
+            list->tail = &((*list->tail)->next);
+            CL_TRACE_WALK(1);
+        }
+    }
+    *list->tail = new_node;  // Link the new node at the end
+    list->tail = &new_node->next;
+    list->length++;  // Increment the length of the list
+    _CL_note_churn(list);
+}
+
+
+
+
+
+// Documented in .h file
+CListElementType CL_nth(CList list, int pos) {
+  return CL_nth_z(list, pos);
+}
+
+
+
+// Documented in .h file
+CListElementType CL_nth_z(CList list, ptrdiff_t pos) {
+  assert(list);
+  CL_TRACE_OP(CLT_OP_NTH, list, pos);
+  if (pos < 0) {
+    pos += (ptrdiff_t) list->length;  // Handle negative indices
+    if (pos < 0) return INVALID_RETURN;  // Out of range
+  }
+  if ((size_t) pos >= list->length) {
+    return INVALID_RETURN;  // Out of bounds
+  }
+
+  if (list->num_segments == 0)
+    return (*_CL_finger_link(list, pos))->element;
+
+  // Skip whole segments recorded by CL_join, without linking them
+  size_t at = (size_t) pos;
+  struct _cl_node *current = list->head;
+  size_t chain_length = list->length - list->segment_length;
+  for (int i = 0; at >= chain_length; i++) {
+    at -= chain_length;
+    current = list->segments[i].head;
+    chain_length = list->segments[i].length;
+  }
+  CL_TRACE_WALK(at);
+  for (size_t i = 0; i < at; i++) {
+    current = current->next;
+  }
+  return current->element;
+}
+
+
+
+
+// Documented in .h file
+bool CL_insert(CList list, CListElementType element, int pos) {
+  return CL_insert_z(list, element, pos);
+}
+
+
+
+// Documented in .h file
+bool CL_insert_z(CList list, CListElementType element, ptrdiff_t pos) {
+  assert(list);  // Ensure the list is valid
+  CL_TRACE_OP(CLT_OP_INSERT, list, pos);
+  _CL_link_segments(list);
+
+  if (pos < 0) {
+    pos = (ptrdiff_t) list->length + pos + 1;  // Convert negative index to positive
+    if (pos < 0) return false;  // Out of range
+  }
+
+  if ((size_t) pos > list->length) return false;  // Out of range
+
+  // The finger is left on the new node's link
+  struct _cl_node **link = _CL_finger_link(list, pos);
+  struct _cl_node *new_node = _CL_new_node(list, element, *link);
+  if (new_node == NULL) return false;  // Memory allocation failed
+
+  *link = new_node;
+  if (list->tail == link)
+    list->tail = &new_node->next;  // Inserted at the end
+  list->length++;
+  _CL_note_churn(list);
+  return true;
+}
+
+
+
+// Documented in .h file
+CListElementType CL_remove(CList list, int pos) {
+  return CL_remove_z(list, pos);
+}
+
+
+
+// Documented in .h file
+CListElementType CL_remove_z(CList list, ptrdiff_t pos) {
+  assert(list);  // Ensure the list is valid
+  CL_TRACE_OP(CLT_OP_REMOVE, list, pos);
+  _CL_link_segments(list);
+
+  if (pos < 0) {
+    pos = (ptrdiff_t) list->length + pos;  // Convert negative index to positive
+    if (pos < 0) return INVALID_RETURN;  // Out of range
+  }
+
+  if ((size_t) pos >= list->length) return INVALID_RETURN;  // Out of range
+
+  // The finger is left on the link, which then leads to the next node
+  struct _cl_node **link = _CL_finger_link(list, pos);
+  struct _cl_node *current = *link;
+
+  CListElementType ret = current->element;  // Store the data to be returned
+
+  *link = current->next;  // Bypass the current node
+  if (list->tail == &current->next)
+    list->tail = link;  // Removed the last node
+
+  _CL_free_node(list, current);  // Free the node
+  list->length--;  // Decrement the length of the list
+  _CL_note_churn(list);
+
+  return ret;  // Return the removed element
+}
+
+
+
+
+// Documented in .h file
+CList CL_copy(CList src_list) {
+  assert(src_list);  // Ensure the source list is valid
+  CL_TRACE_OP(CLT_OP_COPY, src_list, -1);
+  CL_TRACE_WALK(src_list->length);
+
+  CList new_list = CL_new();  // Create a new list
+  new_list->key_cmp = src_list->key_cmp;  // Keys are copied, not recomputed
+  new_list->key_fn = src_list->key_fn;
+  if (src_list->length == 0) return new_list;  // If source is empty, return empty list
+
+  int chain;
+  struct _cl_node *src_node = _CL_first_node(src_list, &chain);  // Segments are copied in order
+  struct _cl_node *new_node = _CL_new_node(new_list, src_node->element, NULL);  // Copy the first node
+  assert(new_node);  // Ensure the node was created successfully
+  new_node->key = src_node->key;
+  new_list->head = new_node;
+  new_list->length = 1;
+
+  src_node = _CL_next_node(src_list, src_node, &chain);  // Move to next node in source list
+
+  struct _cl_node *last_node = new_node;  // Keep track of the last node in new list
+
+  while (src_node != NULL) {
+    CL_PREFETCH(src_node->next);  // Load it while malloc() works
+    new_node = _CL_new_node(new_list, src_node->element, NULL);  // Copy each node
+    assert(new_node);  // Ensure the node was created successfully
+    new_node->key = src_node->key;
+    last_node->next = new_node;  // Link the new node to the list
+    last_node = new_node;  // Update the last node pointer
+    src_node = _CL_next_node(src_list, src_node, &chain);  // Move to next node in source list
+    new_list->length++;  // Increment the length of the new list
+  }
+  new_list->tail = &last_node->next;
+
+  return new_list;
+}
+
+
+
+
+// One part of a list being copied by CL_copy_parallel: a run of
+// count nodes, which may cross the segments recorded by CL_join
+struct _cl_copy_part {
+  CList src_list;
+  struct _cl_node *first;       // the part's first node
+  int chain;                    // segments entered, as _CL_next_node counts
+  size_t count;                 // nodes in the part
+  struct _cl_block *block;      // the copy, made by _CL_copy_part
+  pthread_t thread;
+  bool started;                 // whether thread is copying the part
+};
+
+
+
+/*
+ * Copy one part of a list into a new block of nodes, linked in order,
+ * with the last node's next left NULL. Runs on the thread copying the
+ * part, so that the block comes from that thread's malloc arena.
+ *
+ * Parameters:
+ *   arg      The part, a struct _cl_copy_part; its block is set
+ *
+ * Returns: NULL
+ */
+static void *
+_CL_copy_part(void *arg)
+{
+  struct _cl_copy_part *part = (struct _cl_copy_part *) arg;
+
+  struct _cl_block *block = (struct _cl_block *) malloc(sizeof(*block));
+  assert(block);
+  block->nodes = (struct _cl_node *)
+    malloc(part->count * sizeof(struct _cl_node));
+  assert(block->nodes);
+  block->count = part->count;
+  atomic_init(&block->live, part->count);
+  atomic_init(&block->refs, 0);
+
+  struct _cl_node *nodes = block->nodes;
+  struct _cl_node *src_node = part->first;
+  int chain = part->chain;
+  for (size_t i = 0; i < part->count; i++) {
+    nodes[i].element = src_node->element;
+    nodes[i].key = src_node->key;
+    nodes[i].next = &nodes[i + 1];
+    if (i + 1 < part->count)
+      src_node = _CL_next_node(part->src_list, src_node, &chain);
+  }
+  nodes[part->count - 1].next = NULL;
+
+  part->block = block;
+  return NULL;
+}
+
+
+
+// Documented in .h file
+CList CL_copy_parallel(CList src_list, int num_threads) {
+  assert(src_list);
+  assert(num_threads > 0);
+
+  size_t length = src_list->length;
+  if (length < CL_COPY_PARALLEL_MIN || length == 0)
+    return CL_copy(src_list);
+
+  CL_TRACE_OP(CLT_OP_COPY, src_list, -1);
+  CL_TRACE_WALK(length);
+
+  if ((size_t) num_threads > length)
+    num_threads = (int) length;
+  struct _cl_copy_part *parts = (struct _cl_copy_part *)
+    malloc(num_threads * sizeof(struct _cl_copy_part));
+  assert(parts);
+
+  // Divide the list into parts of equal length. The calling thread
+  // walks to where each part begins, skipping whole segments, and
+  // starts a thread on the part as soon as it is found, so that the
+  // walk to later parts overlaps the copying of earlier ones; it then
+  // copies the last part itself. A part whose thread can not be
+  // started is copied by the calling thread too.
+  struct _cl_node *node = src_list->head;
+  int chain = 0;
+  size_t pos = 0;                       // node's position
+  size_t chain_end = length - src_list->segment_length;
+  for (int t = 0; t < num_threads; t++) {
+    size_t first = length * t / num_threads;
+    while (first >= chain_end) {        // Skip to the segment holding first
+      node = src_list->segments[chain].head;
+      pos = chain_end;
+      chain_end += src_list->segments[chain++].length;
+    }
+    for (; pos < first; pos++)
+      node = node->next;
+
+    parts[t] = (struct _cl_copy_part)
+      {src_list, node, chain, length * (t + 1) / num_threads - first,
+       NULL, 0, false};
+    if (t + 1 < num_threads)
+      parts[t].started =
+        (pthread_create(&parts[t].thread, NULL, _CL_copy_part, &parts[t]) == 0);
+  }
+  _CL_copy_part(&parts[num_threads - 1]);
+  for (int t = 0; t + 1 < num_threads; t++) {
+    if (parts[t].started)
+      pthread_join(parts[t].thread, NULL);
+    else
+      _CL_copy_part(&parts[t]);
+  }
+
+  // Stitch the parts together
+  CList new_list = CL_new();
+  new_list->key_cmp = src_list->key_cmp;  // Keys are copied, not recomputed
+  new_list->key_fn = src_list->key_fn;
+  new_list->head = parts[0].block->nodes;
+  new_list->length = length;
+  for (int t = 0; t < num_threads; t++) {
+    struct _cl_block *block = parts[t].block;
+    struct _cl_node *last = &block->nodes[block->count - 1];
+    if (t + 1 < num_threads)
+      last->next = parts[t + 1].block->nodes;
+    else
+      new_list->tail = &last->next;
+    _CL_add_block(new_list, block);
+  }
+
+  free(parts);
+  return new_list;
+}
+
+
+
+// Documented in .h file
+uint64_t CL_key_prefix(CListElementType element) {
+  const unsigned char *s = (const unsigned char *) element;
+  uint64_t key = 0;
+
+  // Bytes after the NUL stay zero
+  for (int i = 0; i < 8 && s[i] != '\0'; i++)
+    key |= (uint64_t) s[i] << (56 - 8 * i);
+
+  return key;
+}
+
+
+
+// Documented in .h file
+uint64_t CL_key_prefix_nocase(CListElementType element) {
+  const unsigned char *s = (const unsigned char *) element;
+  uint64_t key = 0;
+
+  // Bytes after the NUL stay zero
+  for (int i = 0; i < 8 && s[i] != '\0'; i++)
+    key |= (uint64_t) (unsigned char) tolower(s[i]) << (56 - 8 * i);
+
+  return key;
+}
+
+
+
+// Documented in .h file
+void CL_set_key(CList list, CL_compare_fn cmp, CL_key_fn key) {
+  assert(list);
+
+  list->key_cmp = key ? _CL_canonical_cmp(cmp) : NULL;
+  list->key_fn = key;
+
+  if (key == NULL) return;
+
+  int chain;
+  for (struct _cl_node *node = _CL_first_node(list, &chain); node != NULL;
+       node = _CL_next_node(list, node, &chain)) {
+    node->key = key(node->element);
+  }
+}
+
+
+
+// Documented in .h file
+int CL_insert_sorted(CList list, CListElementType element) {
+  return CL_insert_sorted_cmp(list, element, CL_strcmp);
+}
+
+
+
+// Documented in .h file
+int CL_insert_sorted_cmp(CList list, CListElementType element,
+    CL_compare_fn cmp) {
+  assert(list);
+  assert(cmp);
+  CL_TRACE_OP(CLT_OP_INSERT_SORTED, list, -1);
+  _CL_link_segments(list);
+
+  struct _cl_node *new_node = _CL_new_node(list, element, NULL);
+  int keyed = _CL_keyed(list, cmp);
+  size_t pos = 0;
+
+  // Walk past every element that sorts before or equal to the new one
+  struct _cl_node **tracer = &list->head;
+  while (*tracer != NULL) {
+    struct _cl_node *node = *tracer;
+    if (_CL_compare(cmp, keyed, node->element, node->key,
+                    element, new_node->key) > 0)
+      break;
+    tracer = &node->next;
+    pos++;
+  }
+  CL_TRACE_WALK(pos);
+  CL_TRACE_POS(pos);
+  new_node->next = *tracer;
+  *tracer = new_node;
+  if (list->tail == tracer)
+    list->tail = &new_node->next;  // Inserted at the end
+  list->length++;
+  if (pos < list->finger_pos)
+    list->finger_pos++;  // The finger's node moved up one place
+  _CL_note_churn(list);
+  return _CL_int_pos(pos);
+}
+
+
+
+// Documented in .h file
+int CL_find_sorted(CList list, CListElementType element) {
+  return CL_find_sorted_cmp(list, element, CL_strcmp);
+}
+
+
+
+// Documented in .h file
+int CL_find_sorted_cmp(CList list, CListElementType element,
+    CL_compare_fn cmp) {
+  assert(list);
+  assert(cmp);
+  CL_TRACE_OP(CLT_OP_FIND_SORTED, list, -1);
+
+  int keyed = _CL_keyed(list, cmp);
+  uint64_t key = keyed ? list->key_fn(element) : 0;
+  size_t pos = 0;
+  int chain;
+
+  for (struct _cl_node *node = _CL_first_node(list, &chain); node != NULL;
+       node = _CL_next_node(list, node, &chain)) {
+    int c = _CL_compare(cmp, keyed, node->element, node->key, element, key);
+    CL_TRACE_WALK(1);
+    if (c == 0) {
+      CL_TRACE_POS(pos);
+      return _CL_int_pos(pos);
+    }
+    if (c > 0) break;  // Every later element sorts after this one too
+    pos++;
+  }
+  return -1;
+}
+
+
+
+// Documented in .h file
+void CL_sort(CList list) {
+  CL_sort_cmp(list, CL_strcmp);
+}
+
+
+
+// Documented in .h file
+void CL_sort_cmp(CList list, CL_compare_fn cmp) {
+  assert(list);
+  assert(cmp);
+  CL_TRACE_OP(CLT_OP_SORT, list, -1);
+  CL_TRACE_WALK(list->length);
+  _CL_link_segments(list);
+  _CL_drop_hints(list);
+
+  list->head = _CL_sort_nodes(list->head, cmp, _CL_keyed(list, cmp));
+}
+
+
+
+// Documented in .h file
+void CL_sort_radix(CList list) {
+  assert(list);
+  CL_TRACE_OP(CLT_OP_SORT_RADIX, list, -1);
+  CL_TRACE_WALK(list->length);
+  _CL_link_segments(list);
+  _CL_drop_hints(list);
+
+  if (list->head == NULL) return;
+
+  // The keys are unused if the list does not cache them, so the sort
+  // can use them for the bytes it is sorting by
+  int keyed = _CL_keyed(list, CL_strcmp);
+  bool own = (list->key_fn == NULL);
+  size_t key_depth = (keyed == CL_KEYS_PREFIX) ? 0 : CL_RADIX_NO_KEYS;
+
+  struct _cl_node *tail;
+  list->head = _CL_radix_nodes(list->head, list->length, 0, 0, keyed, own,
+                               key_depth, &tail);
+}
+
+
+
+// Documented in .h file
+void CL_merge_sorted(CList list1, CList list2) {
+  CL_merge_sorted_cmp(list1, list2, CL_strcmp);
+}
+
+
+
+// Documented in .h file
+void CL_merge_sorted_cmp(CList list1, CList list2, CL_compare_fn cmp) {
+  assert(list1);
+  assert(list2);
+  assert(cmp);
+  CL_TRACE_OP(CLT_OP_MERGE_SORTED, list1, -1);
+  CL_TRACE_WALK(list1->length + list2->length);
+  _CL_link_segments(list1);
+  _CL_link_segments(list2);
+  _CL_drop_hints(list1);
+  _CL_drop_hints(list2);
+
+  _CL_adopt_nodes(list1, list2, list2->head);
+
+  list1->head = _CL_merge_nodes(list1->head, list2->head, cmp,
+                                _CL_keyed(list1, cmp));
+  list1->length += list2->length;
+  list2->head = NULL;
+  list2->length = 0;
+}
+
+
+
+/*
+ * Walk two sorted lists in step, removing from list1 the elements
+ * that have (keep_matches false) or do not have (keep_matches true)
+ * a matching element in list2. Each element of list2 matches at most
+ * one element of list1.
+ *
+ * Returns: None
+ */
+static void
+_CL_filter_sorted(CList list1, CList list2, CL_compare_fn cmp,
+                  bool keep_matches)
+{
+  assert(list1);
+  assert(list2);
+  assert(cmp);
+  CL_TRACE_OP(keep_matches ? CLT_OP_INTERSECT_SORTED
+              : CLT_OP_DIFFERENCE_SORTED, list1, -1);
+  CL_TRACE_WALK(list1->length + list2->length);
+  _CL_link_segments(list1);
+  _CL_link_segments(list2);
+  _CL_drop_hints(list1);
+
+  // list2's keys can only be trusted if both lists cache the same ones
+  int keyed = (list1->key_fn == list2->key_fn && _CL_keyed(list2, cmp))
+    ? _CL_keyed(list1, cmp) : CL_KEYS_NONE;
+  struct _cl_node **tracer = &list1->head;
+  struct _cl_node *other = list2->head;
+
+  while (*tracer != NULL) {
+    struct _cl_node *node = *tracer;
+    int c = (other == NULL) ? -1 :
+      _CL_compare(cmp, keyed, node->element, node->key,
+                  other->element, other->key);
+
+    if (c > 0) {
+      other = other->next;  // Nothing left in list1 can match other
+      continue;
+    }
+    if (c == 0)
+      other = other->next;  // other is used up by this match
+
+    if ((c == 0) == keep_matches) {
+      tracer = &node->next;
+    } else {
+      *tracer = node->next;
+      _CL_free_node(list1, node);
+      list1->length--;
+    }
+  }
+}
+
+
+
+// Documented in .h file
+void CL_intersect_sorted(CList list1, CList list2) {
+  _CL_filter_sorted(list1, list2, CL_strcmp, true);
+}
+
+
+
+// Documented in .h file
+void CL_intersect_sorted_cmp(CList list1, CList list2, CL_compare_fn cmp) {
+  _CL_filter_sorted(list1, list2, cmp, true);
+}
+
+
+
+// Documented in .h file
+void CL_difference_sorted(CList list1, CList list2) {
+  _CL_filter_sorted(list1, list2, CL_strcmp, false);
+}
+
+
+
+// Documented in .h file
+void CL_difference_sorted_cmp(CList list1, CList list2, CL_compare_fn cmp) {
+  _CL_filter_sorted(list1, list2, cmp, false);
+}
+
+
+
+// Entry in the heap used by CL_merge_sorted_k: the first remaining
+// node of one of the lists, and that list's index for tie-breaking
+struct _cl_heap_entry {
+  struct _cl_node *node;
+  int src;
+};
+
+
+
+/*
+ * Returns true if heap entry a must be taken before heap entry b
+ */
+static inline bool
+_CL_heap_before(const struct _cl_heap_entry *a, const struct _cl_heap_entry *b,
+                CL_compare_fn cmp, int keyed)
+{
+  int c = _CL_compare(cmp, keyed, a->node->element, a->node->key,
+                      b->node->element, b->node->key);
+  return c < 0 || (c == 0 && a->src < b->src);
+}
+
+
+
+/*
+ * Restore the heap property below position i of a binary min-heap of
+ * n entries
+ *
+ * Returns: None
+ */
+static void
+_CL_heap_sift_down(struct _cl_heap_entry *heap, int n, int i,
+                   CL_compare_fn cmp, int keyed)
+{
+  struct _cl_heap_entry entry = heap[i];
+
+  for (;;) {
+    int child = 2 * i + 1;
+    if (child >= n) break;
+    if (child + 1 < n
+        && _CL_heap_before(&heap[child + 1], &heap[child], cmp, keyed))
+      child++;
+    if (!_CL_heap_before(&heap[child], &entry, cmp, keyed)) break;
+    heap[i] = heap[child];
+    i = child;
+  }
+  heap[i] = entry;
+}
+
+
+
+// Documented in .h file
+CList CL_merge_sorted_k(CList lists[], int num_lists) {
+  return CL_merge_sorted_k_cmp(lists, num_lists, CL_strcmp);
+}
+
+
+
+// Documented in .h file
+CList CL_merge_sorted_k_cmp(CList lists[], int num_lists, CL_compare_fn cmp) {
+  assert(lists || num_lists == 0);
+  assert(cmp);
+
+  CList merged = CL_new();
+  if (num_lists == 0) return merged;
+
+  merged->key_cmp = lists[0]->key_cmp;
+  merged->key_fn = lists[0]->key_fn;
+  int keyed = _CL_keyed(merged, cmp);
+
+  struct _cl_heap_entry *heap =
+    (struct _cl_heap_entry *) malloc(num_lists * sizeof(*heap));
+  assert(heap);
+
+  // Take the chains off the lists and heapify their first nodes
+  int n = 0;
+  for (int i = 0; i < num_lists; i++) {
+    assert(lists[i]);
+    _CL_link_segments(lists[i]);
+    _CL_drop_hints(lists[i]);
+    _CL_adopt_nodes(merged, lists[i], lists[i]->head);
+    if (lists[i]->head != NULL) {
+      heap[n].node = lists[i]->head;
+      heap[n].src = i;
+      n++;
+    }
+    merged->length += lists[i]->length;
+    lists[i]->head = NULL;
+    lists[i]->length = 0;
+  }
+  for (int i = n / 2 - 1; i >= 0; i--)
+    _CL_heap_sift_down(heap, n, i, cmp, keyed);
+
+  struct _cl_node **tracer = &merged->head;
+  while (n > 1) {
+    *tracer = heap[0].node;
+    tracer = &heap[0].node->next;
+    heap[0].node = heap[0].node->next;
+    if (heap[0].node == NULL)
+      heap[0] = heap[--n];  // This chain is used up
+    _CL_heap_sift_down(heap, n, 0, cmp, keyed);
+  }
+  *tracer = (n == 1) ? heap[0].node : NULL;  // Last chain needs no merging
+  merged->tail = (n == 1) ? NULL : tracer;
+
+  free(heap);
+  return merged;
+}
+
+
+
+// Documented in .h file
+int CL_unique(CList list) {
+  return CL_unique_cmp(list, CL_strcmp);
+}
+
+
+
+// Documented in .h file
+int CL_unique_cmp(CList list, CL_compare_fn cmp) {
+  assert(list);
+  assert(cmp);
+  CL_TRACE_OP(CLT_OP_UNIQUE, list, -1);
+  CL_TRACE_WALK(list->length);
+  _CL_link_segments(list);
+  _CL_drop_hints(list);
+
+  int keyed = _CL_keyed(list, cmp);
+  struct _cl_node *removed = NULL;
+  struct _cl_node **removed_tail = &removed;
+  size_t num_removed = 0;
+
+  // Unlink the duplicates onto a chain of their own, so that the
+  // comparison walk is not interleaved with calls to free()
+  struct _cl_node *keep = list->head;
+  while (keep != NULL && keep->next != NULL) {
+    struct _cl_node *node = keep->next;
+    if (_CL_compare(cmp, keyed, keep->element, keep->key,
+                    node->element, node->key) == 0) {
+      keep->next = node->next;
+      *removed_tail = node;
+      removed_tail = &node->next;
+      num_removed++;
+    } else {
+      keep = node;
+    }
+  }
+  *removed_tail = NULL;
+
+  _CL_free_chain(list, removed);
+  list->length -= num_removed;
 
-struct _cl_node {
-  CListElementType element;
-  struct _cl_node *next;
-};
+  return _CL_int_pos(num_removed);
+}
 
-struct _clist {
-  struct _cl_node *head;
-  int length;
+
+
+// Slot of the hash table used by CL_dedup; empty if node is NULL
+struct _cl_hash_slot {
+  uint64_t hash;
+  struct _cl_node *node;
 };
 
 
 
 /*
- * Create (malloc) a new _cl_node and populate it with the supplied
- * values
+ * Hash a string with 64-bit FNV-1a
  *
- * Parameters:
- *   element, next  the values for the node to be created
- * 
- * Returns: The newly-malloc'd node, or NULL in case of error
+ * Returns: The hash
  */
-static struct _cl_node*
-_CL_new_node(CListElementType element, struct _cl_node *next)
+static uint64_t
+_CL_hash_string(const char *s)
 {
-  struct _cl_node* new = (struct _cl_node*) malloc(sizeof(struct _cl_node));
-
-  assert(new);
-
-  new->element = element;
-  new->next = next;
+  uint64_t hash = 0xcbf29ce484222325ULL;
 
-  return new;
+  for (; *s != '\0'; s++) {
+    hash ^= (unsigned char) *s;
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
 }
 
 
 
 // Documented in .h file
-CList CL_new()
-{
-  CList list = (CList) malloc(sizeof(struct _clist));
+int CL_dedup(CList list) {
   assert(list);
+  CL_TRACE_OP(CLT_OP_DEDUP, list, -1);
+  CL_TRACE_WALK(list->length);
+  _CL_link_segments(list);
+  _CL_drop_hints(list);
 
-  list->head = NULL;
-  list->length = 0;
-
-  return list;
-}
-
+  if (list->length < 2) return 0;
 
+  // Open addressing with linear probing, at most half full
+  size_t size = 16;
+  while (size < 2 * list->length)
+    size *= 2;
+  struct _cl_hash_slot *table =
+    (struct _cl_hash_slot *) calloc(size, sizeof(*table));
+  assert(table);
 
-// Documented in .h file
-void CL_free(CList list) {
-    if (list == NULL) return; // Check if list is NULL to prevent accessing invalid memory
+  struct _cl_node *removed = NULL;
+  struct _cl_node **removed_tail = &removed;
+  size_t num_removed = 0;
 
-    struct _cl_node *current = list->head; // Accessing the head pointer from your CList structure
-    while (current != NULL) {
-        struct _cl_node *next = current->next; // Save the next node
-        free(current); // Free the current node
-        current = next; // Move to the next node
+  struct _cl_node **tracer = &list->head;
+  while (*tracer != NULL) {
+    struct _cl_node *node = *tracer;
+
+    uint64_t hash = _CL_hash_string(node->element);
+    size_t i = hash & (size - 1);
+    while (table[i].node != NULL
+           && (table[i].hash != hash
+               || CL_strcmp(table[i].node->element, node->element) != 0))
+      i = (i + 1) & (size - 1);
+
+    if (table[i].node == NULL) {
+      // First occurrence: remember it and keep it
+      table[i].hash = hash;
+      table[i].node = node;
+      tracer = &node->next;
+    } else {
+      *tracer = node->next;
+      *removed_tail = node;
+      removed_tail = &node->next;
+      num_removed++;
     }
-    free(list); // Finally, free the list structure itself
-}
+  }
+  *removed_tail = NULL;
 
+  free(table);
+  _CL_free_chain(list, removed);
+  list->length -= num_removed;
 
+  return _CL_int_pos(num_removed);
+}
 
 
 
-// Documented in .h file
-int CL_length(CList list)
+/*
+ * Unlink every node whose element pred selects, in a single walk,
+ * onto a chain of their own
+ *
+ * Parameters:
+ *   list       The list
+ *   pred       The function that selects the elements to remove
+ *   cb_data    Caller data to pass to the function
+ *   count      Set to the number of nodes unlinked
+ *
+ * Returns: The first node of the NULL-terminated chain of unlinked
+ *   nodes, in list order, or NULL if there were none
+ */
+static struct _cl_node *
+_CL_unlink_if(CList list, CL_predicate_fn pred, void *cb_data, size_t *count)
 {
   assert(list);
-#ifdef DEBUG
-  // In production code, we simply return the stored value for
-  // length. However, as a defensive programming method to prevent
-  // bugs in our code, in DEBUG mode we walk the list and ensure the
-  // number of elements on the list is equal to the stored length.
+  assert(pred);
+  CL_TRACE_WALK(list->length);
+  _CL_link_segments(list);
+  _CL_drop_hints(list);
 
-  int len = 0;
-  for (struct _cl_node *node = list->head; node != NULL; node = node->next)
-    len++;
+  struct _cl_node *removed = NULL;
+  struct _cl_node **removed_tail = &removed;
+  size_t num_removed = 0;
 
-  assert(len == list->length);
-#endif // DEBUG
+  struct _cl_node **tracer = &list->head;
+  while (*tracer != NULL) {
+    struct _cl_node *node = *tracer;
+    if (pred(node->element, cb_data)) {
+      *tracer = node->next;
+      *removed_tail = node;
+      removed_tail = &node->next;
+      num_removed++;
+    } else {
+      tracer = &node->next;
+    }
+  }
+  *removed_tail = NULL;
 
-  return list->length;
+  list->length -= num_removed;
+  *count = num_removed;
+  return removed;
 }
 
 
 
 // Documented in .h file
-void CL_print(CList list)
-{
-  assert(list);
+int CL_remove_if(CList list, CL_predicate_fn pred, void *cb_data) {
+  CL_TRACE_OP(CLT_OP_REMOVE_IF, list, -1);
+  size_t num_removed;
+  struct _cl_node *removed = _CL_unlink_if(list, pred, cb_data, &num_removed);
 
-  int num = 0;
-  for (struct _cl_node *node = list->head; node != NULL; node = node->next)
-    printf("  [%d]: %s\n", num++, node->element);
+  _CL_free_chain(list, removed);
+
+  return _CL_int_pos(num_removed);
 }
 
 
 
 // Documented in .h file
-void CL_push(CList list, CListElementType element)
-{
-  assert(list);
-  list->head = _CL_new_node(element, list->head);
-  list->length++;
+CList CL_extract_if(CList list, CL_predicate_fn pred, void *cb_data) {
+  CL_TRACE_OP(CLT_OP_REMOVE_IF, list, -1);
+  size_t num_removed;
+  struct _cl_node *removed = _CL_unlink_if(list, pred, cb_data, &num_removed);
+
+  CList extracted = CL_new();
+  extracted->key_cmp = list->key_cmp;  // The moved nodes keep their keys
+  extracted->key_fn = list->key_fn;
+  _CL_adopt_nodes(extracted, list, NULL);
+  extracted->head = removed;
+  extracted->length = num_removed;
+  extracted->tail = NULL;
+
+  return extracted;
 }
 
 
 
 // Documented in .h file
-CListElementType CL_pop(CList list)
-{
-  assert(list);
-
-  struct _cl_node *popped_node = list->head;
-
-  if (popped_node == NULL)
-    return INVALID_RETURN;
+void CL_join(CList list1, CList list2) {
+  assert(list1);
+  assert(list2);
+  assert(list1 != list2);
+  CL_TRACE_OP(CLT_OP_JOIN, list1, -1);
+
+  // Record list2's chains as segments of list1, to be linked when
+  // something needs list1's nodes in a single chain. The first one
+  // follows list1's last chain; the others follow the chains of
+  // list2 they followed before.
+  struct _cl_node **link = list1->tail;
+  if (list2->length > 0)
+    list1->tail = list2->tail;  // list2's last chain becomes list1's
+  size_t length = list2->length - list2->segment_length;
+  for (int i = -1; i < list2->num_segments; i++) {
+    struct _cl_node *head = (i < 0) ? list2->head : list2->segments[i].head;
+    if (i >= 0)
+      length = list2->segments[i].length;
+    if (length == 0) continue;  // list2's first chain may be empty
+
+    _CL_adopt_nodes(list1, list2, head);
+    _CL_add_segment(list1, head, length, link);
+    list1->length += length;
+    if (i + 1 < list2->num_segments)
+      link = list2->segments[i + 1].link;
+  }
 
-  CListElementType ret = popped_node->element;
+  list2->head = NULL;  // Clear list2
+  list2->length = 0;
+  list2->num_segments = 0;
+  list2->segment_length = 0;
+  _CL_drop_hints(list2);
+  list2->tail = &list2->head;
+}
 
-  list->head = popped_node->next;
-  free(popped_node);
 
-  list->length--;
 
-  return ret;
+/*
+ * Find the link (head pointer or next field) that points to the node
+ * at a position of the list, so the node there can be replaced or a
+ * node inserted before it.
+ *
+ * Parameters:
+ *   list     The list
+ *   pos      The position, in the range [0, length]
+ *
+ * Returns: The link; *link is NULL if pos == length
+ */
+static struct _cl_node **
+_CL_link_at(CList list, size_t pos)
+{
+  struct _cl_node **tracer = &list->head;
+  CL_TRACE_WALK(pos);
+  for (size_t i = 0; i < pos; i++)
+    tracer = &((*tracer)->next);
+  return tracer;
 }
 
 
 
 // Documented in .h file
-void CL_append(CList list, CListElementType element)
-{
-    assert(list);  // Ensure the list is valid
+CList CL_split(CList list, int pos) {
+  assert(list);
+  CL_TRACE_OP(CLT_OP_SPLIT, list, pos);
+  _CL_link_segments(list);
+  _CL_drop_hints(list);
+
+  ptrdiff_t length = (ptrdiff_t) list->length;
+  ptrdiff_t at = pos;
+
+  if (at < 0)
+    at = length + at + 1;  // Convert negative index to positive
+  if (at < 0 || at > length) return NULL;  // Out of range
+
+  CList tail = CL_new();
+  tail->key_cmp = list->key_cmp;  // The moved nodes keep their keys
+  tail->key_fn = list->key_fn;
+  _CL_adopt_nodes(tail, list, NULL);
+
+  struct _cl_node **link = _CL_link_at(list, at);
+  tail->head = *link;
+  tail->length = list->length - at;
+  tail->tail = NULL;
+  *link = NULL;
+  list->length = at;
+  list->tail = link;
+
+  return tail;
+}
 
-    struct _cl_node *new_node = _CL_new_node(element, NULL);  // Create new node with no next node
-    assert(new_node);  // Ensure the node was created successfully
 
-    if (list->head == NULL) {
-        // If the list is empty, the new node becomes the head
-        list->head = new_node;
-    } else {
-        // Otherwise, traverse to the end of the list and append the new node
-        struct _cl_node *current = list->head;
-        while (current->next != NULL) {
-            current = current->next;
-        }
-        current->next = new_node;
-    }
-    list->length++;  // Increment the length of the list
-}
 
+// Documented in .h file
+bool CL_splice(CList dst, int pos, CList src, int from, int count) {
+  assert(dst);
+  assert(src);
+  assert(dst != src);
+  CL_TRACE_OP(CLT_OP_SPLICE, dst, pos);
+  _CL_link_segments(dst);
+  _CL_link_segments(src);
+  _CL_drop_hints(dst);
+  _CL_drop_hints(src);
+
+  ptrdiff_t dst_length = (ptrdiff_t) dst->length;
+  ptrdiff_t src_length = (ptrdiff_t) src->length;
+  ptrdiff_t to = pos;
+  ptrdiff_t at = from;
+
+  if (to < 0)
+    to = dst_length + to + 1;  // Same rules as CL_insert
+  if (at < 0)
+    at += src_length;  // Same rules as CL_nth
+  if (to < 0 || to > dst_length || at < 0 || count < 0
+      || count > src_length - at)
+    return false;  // Out of range
+  if (count == 0) return true;
+
+  // Cut the chain out of src...
+  struct _cl_node **src_link = _CL_link_at(src, at);
+  struct _cl_node *first = *src_link;
+  struct _cl_node *last = first;
+  CL_TRACE_WALK(count - 1);
+  for (int i = 1; i < count; i++)
+    last = last->next;
+  *src_link = last->next;
+  last->next = NULL;
+  src->length -= count;
+
+  // ...and link it into dst
+  _CL_adopt_nodes(dst, src, first);
+  struct _cl_node **dst_link = _CL_link_at(dst, to);
+  last->next = *dst_link;
+  *dst_link = first;
+  dst->length += count;
 
+  return true;
+}
 
 
 
 // Documented in .h file
-CListElementType CL_nth(CList list, int pos) {
-  assert(list);
-  if (pos < 0) {
-    pos += list->length;  // Handle negative indices
-  }
+void CL_reverse(CList list) {
+  assert(list);  // Ensure the list is valid
+  CL_TRACE_OP(CLT_OP_REVERSE, list, -1);
+  CL_TRACE_WALK(list->length);
+  _CL_link_segments(list);
+  _CL_drop_hints(list);
+
+  struct _cl_node *prev = NULL;
   struct _cl_node *current = list->head;
-  for (int i = 0; current != NULL && i < pos; i++) {
-    current = current->next;
-  }
-  if (current == NULL) {
-    return INVALID_RETURN;  // Out of bounds
+  struct _cl_node *next = NULL;
+
+  while (current != NULL) {
+    next = current->next;  // Store next node
+    current->next = prev;  // Reverse current node's pointer
+    prev = current;  // Move prev and current one step forward
+    current = next;
   }
-  return current->element;
+  list->head = prev;  // Reset head to the new first element
 }
 
 
 
 
 // Documented in .h file
-bool CL_insert(CList list, CListElementType element, int pos) {
-  assert(list);  // Ensure the list is valid
-
-  if (pos < 0) {
-    pos = list->length + pos + 1;  // Convert negative index to positive
-    if (pos < 0) return false;  // Out of range
+void CL_foreach(CList list, CL_foreach_callback callback, void *cb_data) {
+  CL_TRACE_OP(CLT_OP_FOREACH, list, -1);
+  CL_TRACE_WALK(list->length);
+  size_t pos = 0;
+  int chain;
+  struct _cl_node *current = _CL_first_node(list, &chain);
+  while (current != NULL) {
+    callback(_CL_int_pos(pos), current->element, cb_data);
+    current = _CL_next_node(list, current, &chain);
+    pos++;
   }
+}
 
-  if (pos == 0) {  // Insert at the head
-    list->head = _CL_new_node(element, list->head);
-    list->length++;
-    return true;
-  }
 
-  struct _cl_node *current = list->head;
-  for (int i = 0; current != NULL && i < pos - 1; i++) {
-    current = current->next;
-  }
 
-  if (current == NULL) return false;  // Out of range
+// Documented in .h file
+void CL_foreach_z(CList list, CL_foreach_z_callback callback, void *cb_data) {
+  CL_TRACE_OP(CLT_OP_FOREACH_Z, list, -1);
+  CL_TRACE_WALK(list->length);
+  size_t pos = 0;
+  int chain;
+  struct _cl_node *current = _CL_first_node(list, &chain);
+  while (current != NULL) {
+    callback(pos, current->element, cb_data);
+    current = _CL_next_node(list, current, &chain);
+    pos++;
+  }
+}
 
-  // Normal insertion
-  struct _cl_node *new_node = _CL_new_node(element, current->next);
-  if (new_node == NULL) return false;  // Memory allocation failed
 
-  current->next = new_node;
-  list->length++;
-  return true;
-}
 
 
 
-    
-CListElementType CL_remove(CList list, int pos) {
-  assert(list);  // Ensure the list is valid
 
-  if (pos < 0) {
-    pos = list->length + pos;  // Convert negative index to positive
-    if (pos < 0) return INVALID_RETURN;  // Out of range
-  }
 
-  struct _cl_node *current = list->head, *prev = NULL;
-  for (int i = 0; current != NULL && i < pos; i++) {
-    prev = current;
-    current = current->next;
-  }
 
-  if (current == NULL) return INVALID_RETURN;  // Out of range if current is NULL
 
-  CListElementType ret = current->element;  // Store the data to be returned
+// Documented in .h file
+void CL_foreach_batch(CList list, CL_foreach_batch_callback callback,
+    void *cb_data) {
+  assert(list);
+  CL_TRACE_OP(CLT_OP_FOREACH_BATCH, list, -1);
+  CL_TRACE_WALK(list->length);
 
-  // If removing the first element
-  if (prev == NULL) {
-    list->head = current->next;
-  } else {
-    prev->next = current->next;  // Bypass the current node
+  CListElementType batch[CL_FOREACH_BATCH];
+  size_t pos = 0;
+  int chain;
+  struct _cl_node *current = _CL_first_node(list, &chain);
+  while (current != NULL) {
+    int count = 0;
+    for (; current != NULL && count < CL_FOREACH_BATCH;
+         current = _CL_next_node(list, current, &chain))
+      batch[count++] = current->element;
+    callback(_CL_int_pos(pos), batch, count, cb_data);
+    pos += count;
   }
+}
 
-  free(current);  // Free the node
-  list->length--;  // Decrement the length of the list
 
-  return ret;  // Return the removed element
+
+// Documented in .h file
+struct _cl_node *_CL_head(CList list) {
+  assert(list);
+  _CL_link_segments(list);  // CL_FOR_EACH only follows next links
+  return list->head;
 }
 
 
+// Documented in .h file
+CListSlice CL_slice(CList list, int from, int count) {
+  assert(list);
+  _CL_link_segments(list);
+
+  CListSlice slice = { NULL, 0 };
+
+  ptrdiff_t length = (ptrdiff_t) list->length;
+  ptrdiff_t at = from;
+
+  if (at < 0)
+    at += length;  // Same rules as CL_nth
+  if (at < 0 || count <= 0 || count > length - at)
+    return slice;  // Out of range, or nothing to view
+
+  slice.first = *_CL_link_at(list, at);
+  slice.length = count;
+  return slice;
+}
+
 
 
 // Documented in .h file
-CList CL_copy(CList src_list) {
-  assert(src_list);  // Ensure the source list is valid
+int CL_slice_length(CListSlice slice) {
+  return slice.length;
+}
 
-  CList new_list = CL_new();  // Create a new list
-  if (src_list->head == NULL) return new_list;  // If source is empty, return empty list
 
-  struct _cl_node *src_node = src_list->head;
-  struct _cl_node *new_node = _CL_new_node(src_node->element, NULL);  // Copy the first node
-  assert(new_node);  // Ensure the node was created successfully
-  new_list->head = new_node;
-  new_list->length = 1;
 
-  src_node = src_node->next;  // Move to next node in source list
+// Documented in .h file
+CListElementType CL_slice_nth(CListSlice slice, int pos) {
+  if (pos < 0)
+    pos += slice.length;  // Handle negative indices
+  if (pos < 0 || pos >= slice.length)
+    return INVALID_RETURN;  // Out of range
+
+  struct _cl_node *current = slice.first;
+  for (int i = 0; i < pos; i++)
+    current = current->next;
+  return current->element;
+}
+
 
-  struct _cl_node *last_node = new_node;  // Keep track of the last node in new list
 
-  while (src_node != NULL) {
-    new_node = _CL_new_node(src_node->element, NULL);  // Copy each node
-    assert(new_node);  // Ensure the node was created successfully
-    last_node->next = new_node;  // Link the new node to the list
-    last_node = new_node;  // Update the last node pointer
-    src_node = src_node->next;  // Move to next node in source list
-    new_list->length++;  // Increment the length of the new list
+// Documented in .h file
+void CL_slice_foreach(CListSlice slice, CL_foreach_callback callback,
+    void *cb_data) {
+  struct _cl_node *current = slice.first;
+  for (int pos = 0; pos < slice.length; pos++) {
+    callback(pos, current->element, cb_data);
+    current = current->next;
   }
-
-  return new_list;
 }
 
 
 
-int CL_insert_sorted(CList list, CListElementType element) {
-  assert(list);
+// Documented in .h file
+CList CL_slice_copy(CListSlice slice) {
+  CList new_list = CL_new();
+  struct _cl_node **tracer = &new_list->head;
+  struct _cl_node *src_node = slice.first;
 
-  struct _cl_node **tracer = &list->head;
-  while (*tracer && strcmp((*tracer)->element, element) < 0) {
+  for (int i = 0; i < slice.length; i++) {
+    *tracer = _CL_new_node(new_list, src_node->element, NULL);
     tracer = &((*tracer)->next);
+    src_node = src_node->next;
   }
-  struct _cl_node *new_node = _CL_new_node(element, *tracer);
-  if (!new_node) return -1;  // Failed to allocate memory
-  *tracer = new_node;
-  list->length++;
-  return 0;  // Success
+  new_list->length = slice.length;
+  new_list->tail = tracer;
+
+  return new_list;
 }
 
 
 
+
 // Documented in .h file
-void CL_join(CList list1, CList list2) {
-  assert(list1);
-  assert(list2);
-  if (list2->head == NULL) return;  // Nothing to join
-  struct _cl_node *current = list1->head;
-  if (current == NULL) {
-    list1->head = list2->head;  // Directly point head to list2's head if list1 is empty
-  } else {
-    while (current->next != NULL) {  // Find the end of list1
-      current = current->next;
-    }
-    current->next = list2->head;  // Link the end of list1 to the start of list2
+void CL_compact(CList list) {
+  assert(list);
+  CL_TRACE_OP(CLT_OP_COMPACT, list, -1);
+  CL_TRACE_WALK(list->length);
+  _CL_link_segments(list);
+  _CL_drop_hints(list);  // Its node is about to be freed
+
+  size_t length = list->length;
+  if (length == 0) {
+    list->tail = &list->head;
+    return;
   }
-  list1->length += list2->length;  // Update the length
-  list2->head = NULL;  // Clear list2
-  list2->length = 0;
+
+  struct _cl_block *block = (struct _cl_block *) malloc(sizeof(*block));
+  assert(block);
+  block->nodes = (struct _cl_node *) malloc(length * sizeof(struct _cl_node));
+  assert(block->nodes);
+  block->count = length;
+  atomic_init(&block->live, length);
+  atomic_init(&block->refs, 0);
+
+  // Copy the chain into the block in list order, releasing the old
+  // nodes as we go
+  struct _cl_node *nodes = block->nodes;
+  struct _cl_node *old = list->head;
+  for (size_t i = 0; i < length; i++) {
+    struct _cl_node *next = old->next;
+    nodes[i].element = old->element;
+    nodes[i].key = old->key;
+    nodes[i].next = (i + 1 < length) ? &nodes[i + 1] : NULL;
+    _CL_free_node(list, old);
+    old = next;
+  }
+
+  list->head = nodes;
+  list->tail = &nodes[length - 1].next;  // Auto-compaction runs inside CL_append
+  _CL_add_block(list, block);
+  list->churn = 0;
 }
 
 
 
 // Documented in .h file
-void CL_reverse(CList list) {
-  assert(list);  // Ensure the list is valid
+double CL_fragmentation(CList list) {
+  assert(list);
+  _CL_link_segments(list);
 
-  struct _cl_node *prev = NULL;
-  struct _cl_node *current = list->head;
-  struct _cl_node *next = NULL;
+  if (list->length < 2) return 0.0;
 
-  while (current != NULL) {
-    next = current->next;  // Store next node
-    current->next = prev;  // Reverse current node's pointer
-    prev = current;  // Move prev and current one step forward
-    current = next;
+  size_t far = 0;
+  for (struct _cl_node *node = list->head; node->next != NULL; node = node->next) {
+    intptr_t gap = (intptr_t) node->next - (intptr_t) node;
+    if (gap > CL_NEAR_BYTES || gap < -CL_NEAR_BYTES)
+      far++;
   }
-  list->head = prev;  // Reset head to the new first element
+
+  return (double) far / (double) (list->length - 1);
 }
 
 
 
+// Documented in .h file
+bool CL_knows_tail(CList list) {
+  assert(list);
+  return list->tail != NULL;
+}
+
+
 
 // Documented in .h file
-void CL_foreach(CList list, CL_foreach_callback callback, void *cb_data) {
-  int pos = 0;
-  struct _cl_node *current = list->head;
-  while (current != NULL) {
-    callback(pos, current->element, cb_data);
-    current = current->next;
-    pos++;
-  }
+void CL_set_auto_compact(CList list, double threshold) {
+  assert(list);
+
+  list->auto_compact = threshold;
+  list->churn = 0;
 }
 
 
 
+/*
+ * Count a mutation of the list. If automatic compaction is on, the
+ * list's fragmentation is measured once the number of mutations
+ * since the last check reaches the list's length, so the walk costs
+ * amortized constant time per mutation, and the list is compacted if
+ * the fragmentation exceeds the threshold.
+ *
+ * Returns: None
+ */
+static void
+_CL_note_churn(CList list)
+{
+  if (list->auto_compact <= 0.0)
+    return;
 
+  if (++list->churn < list->length || list->churn < CL_AUTO_COMPACT_MIN)
+    return;
 
+  list->churn = 0;
+  if (CL_fragmentation(list) > list->auto_compact)
+    CL_compact(list);
+}
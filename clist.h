@@ -10,6 +10,8 @@
 #define _CLIST_H_
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 // struct _clist is defined in .c file
 typedef struct _clist *CList;
@@ -22,6 +24,13 @@ typedef const char * CListElementType;
 // Used to indicate an error on some functions
 #define INVALID_RETURN NULL
 
+// Positions and lengths in the functions below are int, which limits
+// them to lists of at most INT_MAX elements. The functions with a _z
+// suffix take and return size_t lengths and ptrdiff_t positions
+// instead, and work for lists of any length; on longer lists, int
+// lengths and positions reported by the other functions saturate at
+// INT_MAX.
+
 /*
  * Create a new CList 
  *
@@ -43,6 +52,33 @@ CList CL_new();
 void CL_free(CList list);
 
 
+/*
+ * Destroy a list as CL_free does, but on a background thread. The
+ * list is handed to a reclaimer thread, started on first use, and
+ * this returns at once, so a caller need not wait while a long list
+ * is walked and freed. The list must not be used after this call.
+ * If the reclaimer thread can not be started, the list is freed
+ * before this returns.
+ *
+ * Parameters:
+ *   list   The list; if NULL, no action will occur
+ *
+ * Returns: None
+ */
+void CL_free_deferred(CList list);
+
+
+/*
+ * Wait until every list passed to CL_free_deferred before this call
+ * has been freed, for example before exiting
+ *
+ * Parameters: None
+ *
+ * Returns: None
+ */
+void CL_free_wait();
+
+
 
 /*
  * Compute the length of a list
@@ -55,6 +91,17 @@ void CL_free(CList list);
 int CL_length(CList list);
 
 
+/*
+ * As CL_length, for lists of any length
+ *
+ * Parameters:
+ *   list   The list
+ *
+ * Returns: The length of the list, or 0 if list is empty
+ */
+size_t CL_length_z(CList list);
+
+
 /*
  * Print the list
  *
@@ -91,7 +138,11 @@ CListElementType CL_pop(CList list);
 
 
 /*
- * Append the specfied element to the tail of the list
+ * Append the specfied element to the tail of the list. Takes constant
+ * time, except that the first append after the list has been
+ * reordered or split (by CL_sort, CL_merge_sorted, CL_unique,
+ * CL_remove_if, CL_splice, CL_reverse, CL_compact and the like) walks
+ * the list to find its end.
  *
  * Parameters:
  *   list     The list
@@ -120,12 +171,32 @@ void CL_append(CList list, CListElementType element);
  * 
  * pos must be in the range [-length, length-1] inclusive. If pos is
  * outside this range, returns INVALID_RETURN.
+ *
+ * The list remembers the last node CL_nth, CL_insert or CL_remove
+ * reached (its "finger"), and a later call for the same or a later
+ * position walks on from there instead of from the head, so visiting
+ * the positions of a list in increasing order takes constant time
+ * per call. Going backwards restarts from the head. Because of this,
+ * calls to CL_nth on the same list from several threads must be
+ * serialized, like any other calls on it.
  * 
  * Returns: The requested element, or INVALID_RETURN if no element was found.
  */
 CListElementType CL_nth(CList list, int pos);
 
 
+/*
+ * As CL_nth, for lists of any length
+ *
+ * Parameters:
+ *   list     The list
+ *   pos      Position to return
+ *
+ * Returns: The requested element, or INVALID_RETURN if no element was found.
+ */
+CListElementType CL_nth_z(CList list, ptrdiff_t pos);
+
+
 /*
  * Insert the specified element onto the list at a given position. 
  *
@@ -146,12 +217,28 @@ CListElementType CL_nth(CList list, int pos);
  * 
  * pos must be in the range [-length-1, length] inclusive. If pos is
  * outside this range, returns false.
+ *
+ * Like CL_nth, walks on from the list's finger when it can, and
+ * leaves the finger on the new element.
  * 
  * Returns: true if the operation was successful, false otherwise
  */
 bool CL_insert(CList list, CListElementType element, int pos);
 
 
+/*
+ * As CL_insert, for lists of any length
+ *
+ * Parameters:
+ *   list     The list
+ *   element  The element to insert
+ *   pos      Position to perform the insert
+ *
+ * Returns: true if the operation was successful, false otherwise
+ */
+bool CL_insert_z(CList list, CListElementType element, ptrdiff_t pos);
+
+
 /*
  * Remove an element from the specified position and return it.
  *
@@ -170,6 +257,10 @@ bool CL_insert(CList list, CListElementType element, int pos);
  * 
  * pos must be in the range [-length, length-1] inclusive. If pos is
  * outside this range, returns INVALID_RETURN.
+ *
+ * Like CL_nth, walks on from the list's finger when it can, and
+ * leaves the finger on pos, so removing the element CL_nth just
+ * returned needs no walk.
  * 
  * Returns: The element that was removed, or INVALID_RETURN if no
  *   element was removed.
@@ -177,6 +268,19 @@ bool CL_insert(CList list, CListElementType element, int pos);
 CListElementType CL_remove(CList list, int pos);
 
 
+/*
+ * As CL_remove, for lists of any length
+ *
+ * Parameters:
+ *   list     The list
+ *   pos      Position to perform the removal
+ *
+ * Returns: The element that was removed, or INVALID_RETURN if no
+ *   element was removed.
+ */
+CListElementType CL_remove_z(CList list, ptrdiff_t pos);
+
+
 /*
  * Copy the list. 
  * 
@@ -192,6 +296,111 @@ CListElementType CL_remove(CList list, int pos);
 CList CL_copy(CList src_list);
 
 
+/*
+ * Copy the list as CL_copy does, using several threads. The list is
+ * divided into parts of equal length, each copied by a thread of its
+ * own into a contiguous block of nodes, as CL_compact allocates, and
+ * the blocks are linked together. A block's memory is released once
+ * all of its nodes have been removed.
+ *
+ * The calling thread walks to where each part begins, starting that
+ * part's thread as soon as it gets there, and copies the last part
+ * itself; the walk skips whole lists joined by CL_join. Lists shorter
+ * than CL_COPY_PARALLEL_MIN elements (65536 unless clist.c is built
+ * with it defined otherwise) are copied as CL_copy. The list must not
+ * be changed while it is being copied.
+ *
+ * Parameters:
+ *   src_list     The list to copy
+ *   num_threads  The most threads to copy with, including the calling
+ *                thread; must be greater than 0. The copy is bound by
+ *                memory latency, so threads beyond the number of
+ *                processors only add overhead.
+ *
+ * Returns:  A new list, which is a copy of the argument.
+ */
+CList CL_copy_parallel(CList src_list, int num_threads);
+
+
+/*
+ * Comparison function used by the sorted operations. Returns a value
+ * less than, equal to, or greater than zero if a sorts before, equal
+ * to, or after b, following the conventions of strcmp. strcmp and
+ * strcasecmp may be passed directly.
+ */
+typedef int (*CL_compare_fn)(CListElementType a, CListElementType b);
+
+
+/*
+ * Key extraction function for a comparator. The key of an element is
+ * cached in its node so that most comparisons resolve with a single
+ * integer compare. A key function is only valid for a comparator cmp
+ * if key(a) < key(b) implies cmp(a, b) < 0; elements with equal keys
+ * are ordered by calling cmp.
+ */
+typedef uint64_t (*CL_key_fn)(CListElementType element);
+
+
+/*
+ * Compare two strings; the result has the same sign as that of
+ * strcmp. Where the CPU supports them, chosen at run time, SSE2 or
+ * AVX2 instructions compare 16 or 32 bytes at a time, which pays off
+ * for strings with long common prefixes (URLs, paths). The sorted
+ * operations that follow the rules for strcmp use this function.
+ *
+ * Parameters:
+ *   a, b     The strings to compare
+ *
+ * Returns: A value less than, equal to, or greater than zero if a
+ *   sorts before, equal to, or after b
+ */
+int CL_strcmp(const char *a, const char *b);
+
+
+/*
+ * Key function for strcmp: the first 8 bytes of the string, packed
+ * big-endian into an integer and padded with zeros after the
+ * terminating NUL. When a list caches these keys for strcmp (or
+ * CL_strcmp), elements with equal keys are compared from their ninth
+ * byte on.
+ *
+ * Parameters:
+ *   element  The element
+ *
+ * Returns: The key
+ */
+uint64_t CL_key_prefix(CListElementType element);
+
+
+/*
+ * Key function for strcasecmp: as CL_key_prefix, but each byte is
+ * folded to lower case first.
+ *
+ * Parameters:
+ *   element  The element
+ *
+ * Returns: The key
+ */
+uint64_t CL_key_prefix_nocase(CListElementType element);
+
+
+/*
+ * Cache a key in every node of the list, for use by sorted operations
+ * that are called with comparator cmp. Keys are computed for the
+ * current elements, and for every element added to the list
+ * afterwards. Sorted operations called with any other comparator
+ * ignore the cached keys.
+ *
+ * Parameters:
+ *   list     The list
+ *   cmp      The comparator the keys are consistent with
+ *   key      The key function; if NULL, key caching is turned off
+ *
+ * Returns: None
+ */
+void CL_set_key(CList list, CL_compare_fn cmp, CL_key_fn key);
+
+
 /*
  * Insert a new element into its proper position within a sorted
  * list. Note it is up to the caller to ensure that the list is sorted
@@ -208,6 +417,294 @@ CList CL_copy(CList src_list);
 int CL_insert_sorted(CList list, CListElementType element);
 
 
+/*
+ * As CL_insert_sorted, but the list is ordered by cmp. The element
+ * is inserted after any elements that compare equal to it.
+ *
+ * Parameters:
+ *   list     The list
+ *   element  The element to insert
+ *   cmp      The comparator the list is sorted by
+ *
+ * Returns: The position the element was inserted into
+ */
+int CL_insert_sorted_cmp(CList list, CListElementType element,
+    CL_compare_fn cmp);
+
+
+/*
+ * Find an element in a sorted list. The search stops at the first
+ * element that sorts after the one requested. Sorting is done
+ * following the rules for the strcmp function.
+ *
+ * Parameters:
+ *   list     The list
+ *   element  The element to look for
+ *
+ * Returns: The position of the first element equal to element, or -1
+ *   if there is none
+ */
+int CL_find_sorted(CList list, CListElementType element);
+
+
+/*
+ * As CL_find_sorted, but the list is ordered by cmp.
+ *
+ * Parameters:
+ *   list     The list
+ *   element  The element to look for
+ *   cmp      The comparator the list is sorted by
+ *
+ * Returns: The position of the first element equal to element, or -1
+ *   if there is none
+ */
+int CL_find_sorted_cmp(CList list, CListElementType element,
+    CL_compare_fn cmp);
+
+
+/*
+ * Sort a list following the rules for the strcmp function. The sort
+ * is a stable merge sort that relinks the existing nodes; no memory
+ * is allocated.
+ *
+ * Parameters:
+ *   list     The list
+ *
+ * Returns: None
+ */
+void CL_sort(CList list);
+
+
+/*
+ * As CL_sort, but the list is ordered by cmp.
+ *
+ * Parameters:
+ *   list     The list
+ *   cmp      The comparator to sort by
+ *
+ * Returns: None
+ */
+void CL_sort_cmp(CList list, CL_compare_fn cmp);
+
+
+/*
+ * As CL_sort, but with an MSD radix sort: the nodes are relinked into
+ * buckets by the bytes of their strings, one byte position at a time,
+ * so most elements are never compared. Small buckets are merge
+ * sorted. The order, including that of equal elements, is the same
+ * as CL_sort's, and no memory is allocated.
+ *
+ * Faster than CL_sort on long lists of strings; see "./clist_bench
+ * radix".
+ *
+ * Parameters:
+ *   list     The list
+ *
+ * Returns: None
+ */
+void CL_sort_radix(CList list);
+
+
+/*
+ * Merge two sorted lists. The nodes of list2 are relinked into list1
+ * in sorted order, so no memory is allocated; where elements compare
+ * equal, those from list1 come first. After this operation, list2
+ * will still exist, but it will be empty (length == 0).
+ *
+ * Sorting is done following the rules for the strcmp function.
+ *
+ * Parameters:
+ *   list1    First list, which will grow in size
+ *   list2    Second list, which will be emptied
+ *
+ * Returns: None
+ */
+void CL_merge_sorted(CList list1, CList list2);
+
+
+/*
+ * As CL_merge_sorted, but both lists are ordered by cmp.
+ *
+ * Parameters:
+ *   list1    First list, which will grow in size
+ *   list2    Second list, which will be emptied
+ *   cmp      The comparator both lists are sorted by
+ *
+ * Returns: None
+ */
+void CL_merge_sorted_cmp(CList list1, CList list2, CL_compare_fn cmp);
+
+
+/*
+ * Intersect two sorted lists. Elements of list1 that have no equal
+ * element in list2 are removed from list1; each element of list2
+ * matches at most one element of list1, so duplicates are kept only
+ * as many times as they appear in both lists. list2 is not modified.
+ * Runs in linear time and allocates no memory.
+ *
+ * Sorting is done following the rules for the strcmp function.
+ *
+ * Parameters:
+ *   list1    First list, which holds the result
+ *   list2    Second list
+ *
+ * Returns: None
+ */
+void CL_intersect_sorted(CList list1, CList list2);
+
+
+/*
+ * As CL_intersect_sorted, but both lists are ordered by cmp.
+ *
+ * Parameters:
+ *   list1    First list, which holds the result
+ *   list2    Second list
+ *   cmp      The comparator both lists are sorted by
+ *
+ * Returns: None
+ */
+void CL_intersect_sorted_cmp(CList list1, CList list2, CL_compare_fn cmp);
+
+
+/*
+ * Subtract one sorted list from another. Elements of list1 that have
+ * an equal element in list2 are removed from list1; each element of
+ * list2 removes at most one element of list1. list2 is not modified.
+ * Runs in linear time and allocates no memory.
+ *
+ * Sorting is done following the rules for the strcmp function.
+ *
+ * Parameters:
+ *   list1    First list, which holds the result
+ *   list2    Second list
+ *
+ * Returns: None
+ */
+void CL_difference_sorted(CList list1, CList list2);
+
+
+/*
+ * As CL_difference_sorted, but both lists are ordered by cmp.
+ *
+ * Parameters:
+ *   list1    First list, which holds the result
+ *   list2    Second list
+ *   cmp      The comparator both lists are sorted by
+ *
+ * Returns: None
+ */
+void CL_difference_sorted_cmp(CList list1, CList list2, CL_compare_fn cmp);
+
+
+/*
+ * Merge many sorted lists into a new sorted list, using a heap so
+ * that each node costs O(log num_lists) comparisons. The nodes of the
+ * argument lists are relinked into the result; afterwards the
+ * argument lists will still exist, but they will be empty. Where
+ * elements compare equal, those from lists earlier in the array come
+ * first.
+ *
+ * A new list is allocated and must be destroyed by the caller. It
+ * caches the same keys as lists[0], if any.
+ *
+ * Sorting is done following the rules for the strcmp function.
+ *
+ * Parameters:
+ *   lists      Array of sorted lists
+ *   num_lists  Number of lists in the array
+ *
+ * Returns: A new list holding every element of the argument lists
+ */
+CList CL_merge_sorted_k(CList lists[], int num_lists);
+
+
+/*
+ * As CL_merge_sorted_k, but all the lists are ordered by cmp.
+ *
+ * Parameters:
+ *   lists      Array of sorted lists
+ *   num_lists  Number of lists in the array
+ *   cmp        The comparator all lists are sorted by
+ *
+ * Returns: A new list holding every element of the argument lists
+ */
+CList CL_merge_sorted_k_cmp(CList lists[], int num_lists, CL_compare_fn cmp);
+
+
+/*
+ * Remove adjacent duplicates from a sorted list, keeping the first
+ * element of each run of equal elements. Runs in linear time; the
+ * removed nodes are freed together once the walk is done.
+ *
+ * Sorting is done following the rules for the strcmp function.
+ *
+ * Parameters:
+ *   list     The sorted list
+ *
+ * Returns: The number of elements removed
+ */
+int CL_unique(CList list);
+
+
+/*
+ * As CL_unique, but the list is ordered by cmp.
+ *
+ * Parameters:
+ *   list     The sorted list
+ *   cmp      The comparator the list is sorted by
+ *
+ * Returns: The number of elements removed
+ */
+int CL_unique_cmp(CList list, CL_compare_fn cmp);
+
+
+/*
+ * Remove duplicate elements from a list in any order, keeping the
+ * first occurrence of each and the order of the survivors. Elements
+ * are equal if their strings are equal. Runs in expected linear time,
+ * using a hash table of the distinct elements seen so far.
+ *
+ * Parameters:
+ *   list     The list
+ *
+ * Returns: The number of elements removed
+ */
+int CL_dedup(CList list);
+
+
+typedef bool (*CL_predicate_fn)(CListElementType element, void *cb_data);
+
+/*
+ * Remove every element for which pred returns true, keeping the
+ * order of the others. The list is walked once, calling
+ * pred(element, cb_data) for each element in order, and the removed
+ * nodes are freed together once the walk is done.
+ *
+ * Parameters:
+ *   list       The list
+ *   pred       The function that selects the elements to remove
+ *   cb_data    Caller data to pass to the function
+ *
+ * Returns: The number of elements removed
+ */
+int CL_remove_if(CList list, CL_predicate_fn pred, void *cb_data);
+
+
+/*
+ * As CL_remove_if, but the removed elements are returned, in their
+ * original order, as a new list instead of being freed. The nodes are
+ * moved, not copied.
+ *
+ * Parameters:
+ *   list       The list
+ *   pred       The function that selects the elements to remove
+ *   cb_data    Caller data to pass to the function
+ *
+ * Returns: A new list holding the removed elements
+ */
+CList CL_extract_if(CList list, CL_predicate_fn pred, void *cb_data);
+
+
 /*
  * Join (concatenate) two lists. The contents of list2 are appended
  * to list1. After this operation, list2 will still exist, but it will
@@ -216,6 +713,16 @@ int CL_insert_sorted(CList list, CListElementType element);
  * Example: If list1 = A B C D and list2 = X Y Z, after CL_join
  * returns, list1 will contain A B C D X Y Z and list2 will be empty.
  *
+ * Runs in constant time: the nodes of list2 are recorded as a segment
+ * of list1 and only linked to list1's last node when an operation
+ * needs a single chain of nodes (one that inserts, removes or
+ * reorders elements, or CL_FOR_EACH). Each segment remembers where
+ * the chain before it ends, so linking takes time in the number of
+ * lists joined, not their length; only a list1 whose last node was
+ * not known (after a sort, say) is walked to find it. CL_length, CL_nth, CL_copy, CL_find_sorted
+ * and the CL_foreach functions work across segments without linking
+ * them, and CL_nth and CL_copy_parallel skip whole segments.
+ *
  * Parameters:
  *   list1     First list, which will grow in size
  *   list2     Second list, which will be destroyed.
@@ -225,6 +732,55 @@ int CL_insert_sorted(CList list, CListElementType element);
 void CL_join(CList list1, CList list2);
 
 
+/*
+ * Split a list in two. The elements from position pos to the end of
+ * the list are moved, by relinking their nodes, to a new list; list
+ * keeps the elements before pos.
+ *
+ * Example: If list = A B C D E, after CL_split(list, 3) returns, list
+ * will contain A B C and the returned list will contain D E.
+ *
+ * Parameters:
+ *   list     The list
+ *   pos      Position of the first element of the new list
+ *
+ * pos follows the same rules as for CL_insert: if pos < 0 it counts
+ * from the end of the list, so pos == -1 returns an empty list, and
+ * pos must be in the range [-length-1, length] inclusive.
+ *
+ * A new list is allocated and must be destroyed by the caller.
+ *
+ * Returns: The new list, or NULL if pos is out of range
+ */
+CList CL_split(CList list, int pos);
+
+
+/*
+ * Move count consecutive elements, starting at position from in src,
+ * into dst so that the first of them ends up at position pos. The
+ * nodes are relinked, so no memory is allocated or freed. src and
+ * dst must be different lists.
+ *
+ * Example: If dst = A B C and src = V W X Y Z, after
+ * CL_splice(dst, 1, src, 2, 2) returns, dst will contain A X Y B C
+ * and src will contain V W Z.
+ *
+ * Parameters:
+ *   dst      The list receiving the elements
+ *   pos      Position in dst to move the elements to, following the
+ *            same rules as for CL_insert
+ *   src      The list the elements are taken from
+ *   from     Position of the first element to move, following the
+ *            same rules as for CL_nth
+ *   count    Number of elements to move
+ *
+ * Returns: true if the operation was successful, false if either
+ *   position is out of range or src has fewer than count elements
+ *   starting at from
+ */
+bool CL_splice(CList dst, int pos, CList src, int from, int count);
+
+
 /*
  * Reverse a list.  Specifically, if the original list contained 
  * A B C D (in that order), after a call to CL_reverse, the list
@@ -256,5 +812,218 @@ typedef void (*CL_foreach_callback)(int pos, CListElementType element, void *cb_
 void CL_foreach(CList list, CL_foreach_callback callback, void *cb_data);
 
 
+typedef void (*CL_foreach_z_callback)(size_t pos, CListElementType element,
+    void *cb_data);
+
+/*
+ * As CL_foreach, for lists of any length: callback receives the
+ * element's position as a size_t.
+ *
+ * Parameters:
+ *   list       The list
+ *   callback   The function to call
+ *   cb_data    Caller data to pass to the function
+ *
+ * Returns: None
+ */
+void CL_foreach_z(CList list, CL_foreach_z_callback callback, void *cb_data);
+
+
+// Largest number of elements passed to one CL_foreach_batch callback
+#define CL_FOREACH_BATCH 64
+
+typedef void (*CL_foreach_batch_callback)(int pos,
+    const CListElementType *elements, int count, void *cb_data);
+
+/*
+ * Iterate through the list, calling callback once for each batch of
+ * up to CL_FOREACH_BATCH consecutive elements rather than once per
+ * element. Each call to callback will be of the form
+ *
+ *   callback( <position of elements[0]>, <elements>, <count>, <cb_data> )
+ *
+ * The elements array is only valid during the call.
+ *
+ * Parameters:
+ *   list       The list
+ *   callback   The function to call
+ *   cb_data    Caller data to pass to the function
+ *
+ * Returns: None
+ */
+void CL_foreach_batch(CList list, CL_foreach_batch_callback callback,
+    void *cb_data);
+
+
+// A node of a list. The layout is only public so that CL_FOR_EACH
+// can walk the nodes inline; use the functions in this file instead.
+struct _cl_node {
+  CListElementType element;
+  struct _cl_node *next;
+  uint64_t key;                 // cached key, valid if the list caches keys
+};
+
+// Returns the first node of a list, for CL_FOR_EACH
+struct _cl_node *_CL_head(CList list);
+
+/*
+ * Loop over the elements of a list, assigning each in turn to elem,
+ * which must be a CListElementType variable declared by the caller:
+ *
+ *   CListElementType elem;
+ *   CL_FOR_EACH(list, elem) {
+ *     ...
+ *   }
+ *
+ * The loop body is compiled in place, so unlike CL_foreach no call is
+ * made per element; break and continue work as in any loop. The body
+ * must not add elements to or remove elements from the list.
+ */
+#define CL_FOR_EACH(list, elem)                                         \
+  for (struct _cl_node *_cl_node_ = _CL_head(list);                     \
+       _cl_node_ != NULL && ((elem) = _cl_node_->element, 1);           \
+       _cl_node_ = _cl_node_->next)
+
+
+// A view of a range of consecutive elements of a list, which refers
+// to the list's own nodes. A slice remains valid until an element in
+// its range is removed, or the list is freed; it needs no cleanup.
+typedef struct {
+  struct _cl_node *first;
+  int length;
+} CListSlice;
+
+
+/*
+ * Make a slice of a list, without copying or allocating anything.
+ *
+ * Parameters:
+ *   list     The list
+ *   from     Position of the first element of the slice, following
+ *            the same rules as for CL_nth
+ *   count    Number of elements in the slice
+ *
+ * Returns: The slice, or an empty slice if from is out of range or
+ *   the list has fewer than count elements starting at from
+ */
+CListSlice CL_slice(CList list, int from, int count);
+
+
+/*
+ * Compute the length of a slice
+ *
+ * Parameters:
+ *   slice    The slice
+ *
+ * Returns: The number of elements in the slice
+ */
+int CL_slice_length(CListSlice slice);
+
+
+/*
+ * Return the Nth element of a slice, counting 0 as the first element
+ * of the slice. Negative positions count from the end of the slice,
+ * as for CL_nth.
+ *
+ * Parameters:
+ *   slice    The slice
+ *   pos      Position to return
+ *
+ * Returns: The requested element, or INVALID_RETURN if pos is out of
+ *   range
+ */
+CListElementType CL_slice_nth(CListSlice slice, int pos);
+
+
+/*
+ * Call callback for each element of a slice, as for CL_foreach.
+ * Positions passed to callback are relative to the slice.
+ *
+ * Parameters:
+ *   slice      The slice
+ *   callback   The function to call
+ *   cb_data    Caller data to pass to the function
+ *
+ * Returns: None
+ */
+void CL_slice_foreach(CListSlice slice, CL_foreach_callback callback,
+    void *cb_data);
+
+
+/*
+ * Copy the elements of a slice into a new list, which must be
+ * destroyed by the caller.
+ *
+ * Parameters:
+ *   slice    The slice
+ *
+ * Returns: A new list holding the elements of the slice
+ */
+CList CL_slice_copy(CListSlice slice);
+
+
+/*
+ * Compact a list: move its elements into a single newly allocated,
+ * contiguous block of nodes, in list order, and release the old
+ * nodes. This restores scan speed after a long run of insertions and
+ * removals has scattered the nodes across the heap. The block's
+ * memory is released once all of its nodes have been removed.
+ *
+ * Compaction moves every node, so any slice of the list becomes
+ * invalid.
+ *
+ * Parameters:
+ *   list     The list
+ *
+ * Returns: None
+ */
+void CL_compact(CList list);
+
+
+/*
+ * Measure how scattered a list's nodes are, as the fraction of links
+ * between consecutive elements that jump to a distant address. A
+ * freshly compacted list scores 0.0; a list whose nodes are in random
+ * order across the heap scores close to 1.0. Runs in linear time.
+ *
+ * Parameters:
+ *   list     The list
+ *
+ * Returns: The fragmentation, between 0.0 and 1.0
+ */
+double CL_fragmentation(CList list);
+
+
+/*
+ * Report whether the list knows where its last node is, so that
+ * CL_append takes constant time. Functions that reorder or split a
+ * list forget it, and the next CL_append walks to the end to find it
+ * again.
+ *
+ * Parameters:
+ *   list     The list
+ *
+ * Returns: true if CL_append will not walk the list
+ */
+bool CL_knows_tail(CList list);
+
+
+/*
+ * Compact a list automatically. Once the list has been mutated (by
+ * CL_push, CL_pop, CL_append, CL_insert, CL_remove or
+ * CL_insert_sorted) about as many times as it has elements, its
+ * fragmentation is measured, and CL_compact is called if it exceeds
+ * threshold. The cost of measuring is amortized over the mutations.
+ *
+ * Parameters:
+ *   list       The list
+ *   threshold  Fragmentation above which to compact; 0.0 (the default
+ *              for new lists) turns automatic compaction off
+ *
+ * Returns: None
+ */
+void CL_set_auto_compact(CList list, double threshold);
+
+
 
 #endif /* _CLIST_H_ */
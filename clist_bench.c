@@ -0,0 +1,1337 @@
+/*
+ * clist_bench.c
+ *
+ * Benchmarks for CLists. Build with "make bench", which compiles
+ * with optimization, without the sanitizer and without the DEBUG
+ * consistency checks in clist.c.
+ *
+ * Usage: ./clist_bench [benchmark [n]]
+ *
+ * With no arguments every benchmark is run at its default size.
+ *
+ * Built with "make bench-trace", the benchmarks trace the list
+ * operations they run, and write the events to clist_bench.trace.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "./clist.h"
+#include "./clist_compact.h"
+#include "./clist_pq.h"
+#include "./clist_ring.h"
+#include "./clist_queue.h"
+#include "./clist_trace.h"
+#include "./clist_rcu.h"
+#include "./clist_shard.h"
+
+
+// Current time in seconds, from a monotonic clock
+static double bench_now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Print one timing line
+static void bench_report(const char *what, int n, double seconds)
+{
+  printf("  %-40s n=%-9d %10.3f ms\n", what, n, seconds * 1e3);
+}
+
+// Bytes currently allocated from the heap, or 0 if unknown
+static size_t bench_heap_bytes()
+{
+#ifdef __GLIBC__
+  return mallinfo2().uordblks;
+#else
+  return 0;
+#endif
+}
+
+// Simple xorshift generator, so runs are repeatable
+static unsigned long bench_rand_state = 88172645463325252UL;
+
+static unsigned long bench_rand()
+{
+  bench_rand_state ^= bench_rand_state << 13;
+  bench_rand_state ^= bench_rand_state >> 7;
+  bench_rand_state ^= bench_rand_state << 17;
+  return bench_rand_state;
+}
+
+/*
+ * Make n random strings of the form <prefix><12 random letters>. The
+ * strings are allocated in one block, which bench_free_keys releases.
+ */
+static const char **bench_make_keys(int n, const char *prefix)
+{
+  size_t plen = strlen(prefix);
+  size_t stride = plen + 13;
+  char *block = (char *) malloc(stride * n);
+  const char **keys = (const char **) malloc(sizeof(*keys) * (n + 1));
+
+  for (int i = 0; i < n; i++) {
+    char *s = block + stride * i;
+    memcpy(s, prefix, plen);
+    for (int j = 0; j < 12; j++)
+      s[plen + j] = 'a' + bench_rand() % 26;
+    s[plen + 12] = '\0';
+    keys[i] = s;
+  }
+  keys[n] = block;  // Remembered for bench_free_keys
+
+  return keys;
+}
+
+static void bench_free_keys(const char **keys, int n)
+{
+  free((void *) keys[n]);
+  free(keys);
+}
+
+// A sorted list of keys[from..to)
+static CList bench_sorted_list(const char **keys, int from, int to)
+{
+  CList list = CL_new();
+  for (int i = from; i < to; i++)
+    CL_push(list, keys[i]);
+  CL_sort(list);
+  return list;
+}
+
+
+/*
+ * Union of two sorted lists of n elements each: inserting every
+ * element of one into the other, against CL_merge_sorted
+ */
+static void bench_merge(int n)
+{
+  const char **keys = bench_make_keys(2 * n, "");
+  double t;
+
+  CList a = bench_sorted_list(keys, 0, n);
+  CList b = bench_sorted_list(keys, n, 2 * n);
+  t = bench_now();
+  while (CL_length(b) > 0)
+    CL_insert_sorted(a, CL_pop(b));
+  bench_report("union by CL_insert_sorted", n, bench_now() - t);
+  CL_free(a);
+  CL_free(b);
+
+  a = bench_sorted_list(keys, 0, n);
+  b = bench_sorted_list(keys, n, 2 * n);
+  t = bench_now();
+  CL_merge_sorted(a, b);
+  bench_report("union by CL_merge_sorted", n, bench_now() - t);
+  CL_free(a);
+  CL_free(b);
+
+  bench_free_keys(keys, 2 * n);
+}
+
+
+/*
+ * Intersection and difference of two sorted lists of n elements that
+ * share half their elements: building the result with CL_find_sorted
+ * and CL_append, against CL_intersect_sorted and CL_difference_sorted
+ */
+static void bench_setops(int n)
+{
+  const char **keys = bench_make_keys(n + n / 2, "");
+  double t;
+
+  CList a = bench_sorted_list(keys, 0, n);
+  CList b = bench_sorted_list(keys, n / 2, n + n / 2);
+
+  t = bench_now();
+  CList result = CL_new();
+  for (int i = 0; i < CL_length(a); i++) {
+    const char *e = CL_nth(a, i);
+    if (CL_find_sorted(b, e) >= 0)
+      CL_append(result, e);
+  }
+  bench_report("intersection by CL_find_sorted", n, bench_now() - t);
+  CL_free(result);
+
+  CList c = CL_copy(a);
+  t = bench_now();
+  CL_intersect_sorted(a, b);
+  bench_report("intersection by CL_intersect_sorted", n, bench_now() - t);
+
+  t = bench_now();
+  CL_difference_sorted(c, b);
+  bench_report("difference by CL_difference_sorted", n, bench_now() - t);
+
+  CL_free(a);
+  CL_free(b);
+  CL_free(c);
+  bench_free_keys(keys, n + n / 2);
+}
+
+
+/*
+ * Merging 64 sorted lists holding n elements in total: inserting
+ * each element, merging the lists pairwise in turn, and a single
+ * heap-based CL_merge_sorted_k
+ */
+static void bench_kway(int n)
+{
+  const int k = 64;
+  const char **keys = bench_make_keys(n, "");
+  CList lists[64];
+  double t;
+
+  for (int i = 0; i < k; i++)
+    lists[i] = bench_sorted_list(keys, (long) n * i / k, (long) n * (i + 1) / k);
+  t = bench_now();
+  for (int i = 1; i < k; i++)
+    while (CL_length(lists[i]) > 0)
+      CL_insert_sorted(lists[0], CL_pop(lists[i]));
+  bench_report("64-way merge by CL_insert_sorted", n, bench_now() - t);
+  for (int i = 0; i < k; i++)
+    CL_free(lists[i]);
+
+  for (int i = 0; i < k; i++)
+    lists[i] = bench_sorted_list(keys, (long) n * i / k, (long) n * (i + 1) / k);
+  t = bench_now();
+  for (int i = 1; i < k; i++)
+    CL_merge_sorted(lists[0], lists[i]);
+  bench_report("64-way merge by CL_merge_sorted", n, bench_now() - t);
+  for (int i = 0; i < k; i++)
+    CL_free(lists[i]);
+
+  for (int i = 0; i < k; i++)
+    lists[i] = bench_sorted_list(keys, (long) n * i / k, (long) n * (i + 1) / k);
+  t = bench_now();
+  CList merged = CL_merge_sorted_k(lists, k);
+  bench_report("64-way merge by CL_merge_sorted_k", n, bench_now() - t);
+  CL_free(merged);
+  for (int i = 0; i < k; i++)
+    CL_free(lists[i]);
+
+  bench_free_keys(keys, n);
+}
+
+
+// Counts the elements passed to a foreach function
+static void bench_count(int pos, const char *element, void *cb_data)
+{
+  (void) pos;
+  (void) element;
+  (*(long *) cb_data)++;
+}
+
+
+/*
+ * Memory use, build, scan and free time of an n-element CList
+ * against a CListCompact
+ */
+static void bench_compact(int n)
+{
+  const char **keys = bench_make_keys(n, "");
+  long count = 0;
+  double t;
+  size_t heap;
+
+  heap = bench_heap_bytes();
+  t = bench_now();
+  CList list = CL_new();
+  for (int i = n - 1; i >= 0; i--)
+    CL_push(list, keys[i]);
+  bench_report("CList build by CL_push", n, bench_now() - t);
+  printf("  %-40s %.1f bytes/element\n", "CList heap use",
+         (double) (bench_heap_bytes() - heap) / n);
+  t = bench_now();
+  CL_foreach(list, bench_count, &count);
+  bench_report("CList scan by CL_foreach", n, bench_now() - t);
+  t = bench_now();
+  CL_free(list);
+  bench_report("CList CL_free", n, bench_now() - t);
+
+  heap = bench_heap_bytes();
+  t = bench_now();
+  CListCompact compact = CLC_new();
+  for (int i = 0; i < n; i++)
+    CLC_append(compact, keys[i]);
+  bench_report("CListCompact build by CLC_append", n, bench_now() - t);
+  printf("  %-40s %.1f bytes/element\n", "CListCompact heap use",
+         (double) (bench_heap_bytes() - heap) / n);
+  t = bench_now();
+  CLC_foreach(compact, bench_count, &count);
+  bench_report("CListCompact scan by CLC_foreach", n, bench_now() - t);
+  t = bench_now();
+  CLC_free(compact);
+  bench_report("CListCompact CLC_free", n, bench_now() - t);
+
+  bench_free_keys(keys, n);
+}
+
+
+// Does a little work on each element, as a typical callback would
+static void bench_hash(int pos, const char *element, void *cb_data)
+{
+  (void) pos;
+  unsigned long *hash = (unsigned long *) cb_data;
+  for (int i = 0; i < 4 && element[i] != '\0'; i++)
+    *hash = *hash * 31 + element[i];
+}
+
+
+/*
+ * Scan, copy, reverse and free time of an n-element list whose nodes
+ * are scattered across the heap: the list is sorted after building,
+ * so that list order no longer follows allocation order.
+ */
+static void bench_scattered(int n)
+{
+  const char **keys = bench_make_keys(n, "");
+  unsigned long hash = 0;
+  long count = 0;
+  double t;
+
+  CList list = CL_new();
+  for (int i = 0; i < n; i++)
+    CL_push(list, keys[i]);
+  CL_sort(list);
+
+  t = bench_now();
+  CL_foreach(list, bench_count, &count);
+  bench_report("scattered scan, counting", n, bench_now() - t);
+  t = bench_now();
+  CL_foreach(list, bench_hash, &hash);
+  bench_report("scattered scan, hashing elements", n, bench_now() - t);
+  t = bench_now();
+  CList copy = CL_copy(list);
+  bench_report("scattered CL_copy", n, bench_now() - t);
+  t = bench_now();
+  CL_reverse(list);
+  bench_report("scattered CL_reverse", n, bench_now() - t);
+  t = bench_now();
+  CL_free(list);
+  bench_report("scattered CL_free", n, bench_now() - t);
+  CL_free(copy);
+
+  bench_free_keys(keys, n);
+}
+
+
+/*
+ * Scan time of a scattered n-element list before and after
+ * CL_compact
+ */
+static void bench_compaction(int n)
+{
+  const char **keys = bench_make_keys(n, "");
+  unsigned long hash = 0;
+  double t;
+
+  CList list = CL_new();
+  for (int i = 0; i < n; i++)
+    CL_push(list, keys[i]);
+  CL_sort(list);
+
+  printf("  %-40s %.3f\n", "fragmentation before", CL_fragmentation(list));
+  t = bench_now();
+  CL_foreach(list, bench_hash, &hash);
+  bench_report("scan before CL_compact", n, bench_now() - t);
+
+  t = bench_now();
+  CL_compact(list);
+  bench_report("CL_compact", n, bench_now() - t);
+
+  printf("  %-40s %.3f\n", "fragmentation after", CL_fragmentation(list));
+  t = bench_now();
+  CL_foreach(list, bench_hash, &hash);
+  bench_report("scan after CL_compact", n, bench_now() - t);
+
+  CL_free(list);
+  bench_free_keys(keys, n);
+}
+
+
+/*
+ * String comparison on keys sharing a 48-byte prefix: strcmp from the
+ * C library against CL_strcmp, alone and inside CL_sort and
+ * CL_insert_sorted, with and without cached prefix keys
+ */
+static void bench_strcmp(int n)
+{
+  const char *prefix = "https://www.example.com/static/assets/img/2024/";
+  const char **keys = bench_make_keys(n, prefix);
+  int (*volatile libc_strcmp)(const char *, const char *) = strcmp;
+  long sum = 0;
+  double t;
+
+  t = bench_now();
+  for (int i = 1; i < n; i++)
+    sum += libc_strcmp(keys[i - 1], keys[i]) < 0;
+  bench_report("n-1 compares by strcmp", n, bench_now() - t);
+  t = bench_now();
+  for (int i = 1; i < n; i++)
+    sum -= CL_strcmp(keys[i - 1], keys[i]) < 0;
+  bench_report("n-1 compares by CL_strcmp", n, bench_now() - t);
+
+  for (int keyed = 0; keyed <= 1; keyed++) {
+    for (int fast = 0; fast <= 1; fast++) {
+      CList list = CL_new();
+      if (keyed)
+        CL_set_key(list, strcmp, CL_key_prefix);
+      for (int i = 0; i < n; i++)
+        CL_push(list, keys[i]);
+
+      char what[64];
+      snprintf(what, sizeof(what), "CL_sort by %s%s", fast ? "CL_strcmp" : "strcmp",
+               keyed ? ", prefix keys" : "");
+      t = bench_now();
+      CL_sort_cmp(list, fast ? CL_strcmp : libc_strcmp);
+      bench_report(what, n, bench_now() - t);
+
+      snprintf(what, sizeof(what), "100 CL_insert_sorted by %s%s",
+               fast ? "CL_strcmp" : "strcmp", keyed ? ", prefix keys" : "");
+      t = bench_now();
+      for (int i = 0; i < 100; i++)
+        CL_insert_sorted_cmp(list, keys[(i * 7919) % n],
+                             fast ? CL_strcmp : libc_strcmp);
+      bench_report(what, n, bench_now() - t);
+      CL_free(list);
+    }
+  }
+
+  if (sum == 42) printf("\n");  // Keep the compare loops alive
+  bench_free_keys(keys, n);
+}
+
+
+// State for bench_member: the element looked for, and whether seen
+struct bench_lookup {
+  const char *element;
+  bool found;
+};
+
+static void bench_member(int pos, const char *element, void *cb_data)
+{
+  (void) pos;
+  struct bench_lookup *lookup = (struct bench_lookup *) cb_data;
+  if (strcmp(element, lookup->element) == 0)
+    lookup->found = true;
+}
+
+
+/*
+ * Removing duplicates from n elements, each of n/2 keys appearing
+ * twice: building a second list and checking membership with a
+ * CL_foreach scan, against CL_dedup, and against CL_sort followed by
+ * CL_unique
+ */
+static void bench_dedup(int n)
+{
+  const char **keys = bench_make_keys(n / 2, "");
+  double t;
+
+  CList list = CL_new();
+  for (int i = 0; i < n; i++)
+    CL_push(list, keys[bench_rand() % (n / 2)]);
+  CList copy = CL_copy(list);
+
+  t = bench_now();
+  CList result = CL_new();
+  for (int i = 0; i < CL_length(list); i++) {
+    struct bench_lookup lookup = {CL_nth(list, i), false};
+    CL_foreach(result, bench_member, &lookup);
+    if (!lookup.found)
+      CL_push(result, lookup.element);
+  }
+  bench_report("dedup by CL_foreach scan", n, bench_now() - t);
+  CL_free(result);
+
+  t = bench_now();
+  CL_dedup(list);
+  bench_report("dedup by CL_dedup", n, bench_now() - t);
+
+  t = bench_now();
+  CL_sort(copy);
+  CL_unique(copy);
+  bench_report("dedup by CL_sort and CL_unique", n, bench_now() - t);
+  if (CL_length(copy) != CL_length(list))
+    printf("  length mismatch!\n");
+
+  CL_free(list);
+  CL_free(copy);
+  bench_free_keys(keys, n / 2);
+}
+
+
+/*
+ * A priority queue held at a steady depth while n elements go
+ * through it, each pop followed by a push (the "hold" model): a
+ * sorted CList with CL_insert_sorted and CL_pop, against a CListPQ
+ */
+static void bench_pq(int n)
+{
+  static const int depths[] = {16, 256, 4096};
+  const int max_depth = depths[sizeof(depths) / sizeof(depths[0]) - 1];
+  const char **keys = bench_make_keys(n + max_depth, "");
+  char what[64];
+  double t;
+
+  for (size_t d = 0; d < sizeof(depths) / sizeof(depths[0]); d++) {
+    int depth = depths[d];
+    long sum = 0;
+
+    CList list = CL_new();
+    for (int i = 0; i < depth; i++)
+      CL_insert_sorted(list, keys[i]);
+    t = bench_now();
+    for (int i = 0; i < n; i++) {
+      sum += CL_pop(list)[0];
+      CL_insert_sorted(list, keys[depth + i]);
+    }
+    snprintf(what, sizeof(what), "depth %d, CL_insert_sorted/CL_pop", depth);
+    bench_report(what, n, bench_now() - t);
+    CL_free(list);
+
+    CListPQ pq = PQ_new();
+    for (int i = 0; i < depth; i++)
+      PQ_push(pq, keys[i]);
+    t = bench_now();
+    for (int i = 0; i < n; i++) {
+      sum -= PQ_pop_min(pq)[0];
+      PQ_push(pq, keys[depth + i]);
+    }
+    snprintf(what, sizeof(what), "depth %d, PQ_push/PQ_pop_min", depth);
+    bench_report(what, n, bench_now() - t);
+    PQ_free(pq);
+
+    if (sum != 0)
+      printf("  order mismatch!\n");
+  }
+
+  bench_free_keys(keys, n + max_depth);
+}
+
+
+/*
+ * A FIFO window of 1024 elements while n elements go through it, each
+ * append followed by a pop: a CList with CL_append and CL_pop, against
+ * a CListRing
+ */
+static void bench_ring(int n)
+{
+  const int window = 1024;
+  const char **keys = bench_make_keys(window, "");
+  long sum = 0;
+  double t;
+
+  CList list = CL_new();
+  for (int i = 0; i < window; i++)
+    CL_append(list, keys[i]);
+  t = bench_now();
+  for (int i = 0; i < n; i++) {
+    sum += CL_pop(list)[0];
+    CL_append(list, keys[i % window]);
+  }
+  bench_report("window by CL_append/CL_pop", n, bench_now() - t);
+  CL_free(list);
+
+  CListRing ring = CLR_new(window, CLR_OVERWRITE);
+  for (int i = 0; i < window; i++)
+    CLR_append(ring, keys[i]);
+  t = bench_now();
+  for (int i = 0; i < n; i++) {
+    sum -= CLR_pop(ring)[0];
+    CLR_append(ring, keys[i % window]);
+  }
+  bench_report("window by CLR_append/CLR_pop", n, bench_now() - t);
+
+  t = bench_now();
+  for (int i = 0; i < n; i++)
+    CLR_append(ring, keys[i % window]);  // Full: overwrites the oldest
+  bench_report("window by CLR_append, overwriting", n, bench_now() - t);
+  CLR_free(ring);
+
+  if (sum != 0)
+    printf("  order mismatch!\n");
+  bench_free_keys(keys, window);
+}
+
+
+static void bench_count_batch(int pos, const char * const *elements, int count,
+    void *cb_data)
+{
+  (void) pos;
+  (void) elements;
+  *(long *) cb_data += count;
+}
+
+static void bench_first_char(int pos, const char *element, void *cb_data)
+{
+  (void) pos;
+  *(long *) cb_data += element[0];
+}
+
+static void bench_first_char_batch(int pos, const char * const *elements,
+    int count, void *cb_data)
+{
+  (void) pos;
+  long sum = 0;
+  for (int i = 0; i < count; i++)
+    sum += elements[i][0];
+  *(long *) cb_data += sum;
+}
+
+
+/*
+ * Scanning an n-element list with a tiny loop body: a callback per
+ * element with CL_foreach, a callback per batch with CL_foreach_batch,
+ * and the body inline with CL_FOR_EACH. The list is compacted, so
+ * that the scans are not dominated by cache misses.
+ */
+static void bench_foreach(int n)
+{
+  const char **keys = bench_make_keys(n, "");
+  long count = 0, sum = 0;
+  double t;
+
+  CList list = CL_new();
+  for (int i = 0; i < n; i++)
+    CL_push(list, keys[i]);
+  CL_compact(list);
+
+  t = bench_now();
+  CL_foreach(list, bench_count, &count);
+  bench_report("counting by CL_foreach", n, bench_now() - t);
+  t = bench_now();
+  CL_foreach_batch(list, bench_count_batch, &count);
+  bench_report("counting by CL_foreach_batch", n, bench_now() - t);
+  t = bench_now();
+  CListElementType elem;
+  CL_FOR_EACH(list, elem)
+    count++;
+  bench_report("counting by CL_FOR_EACH", n, bench_now() - t);
+
+  t = bench_now();
+  CL_foreach(list, bench_first_char, &sum);
+  bench_report("summing first chars by CL_foreach", n, bench_now() - t);
+  t = bench_now();
+  CL_foreach_batch(list, bench_first_char_batch, &sum);
+  bench_report("summing first chars by CL_foreach_batch", n, bench_now() - t);
+  t = bench_now();
+  CL_FOR_EACH(list, elem)
+    sum += elem[0];
+  bench_report("summing first chars by CL_FOR_EACH", n, bench_now() - t);
+
+  if (count != 3L * n || sum % 3 != 0)
+    printf("  count mismatch!\n");
+  CL_free(list);
+  bench_free_keys(keys, n);
+}
+
+
+/*
+ * Fan-in of n lists of 10 elements each into one: joining them with
+ * a splice at the end of the result, which walks the result each
+ * time, against CL_join, which records each list as a segment; then
+ * reading the result across its segments, and the first mutation,
+ * which links them
+ */
+static void bench_join(int n)
+{
+  const int each = 10;
+  const char **keys = bench_make_keys(each, "");
+  long count = 0;
+  double t;
+
+  CList *lists = (CList *) malloc(n * sizeof(CList));
+  for (int i = 0; i < n; i++) {
+    lists[i] = CL_new();
+    for (int j = 0; j < each; j++)
+      CL_push(lists[i], keys[j]);
+  }
+
+  CList result = CL_new();
+  t = bench_now();
+  for (int i = 0; i < n; i++)
+    CL_splice(result, -1, lists[i], 0, each);
+  bench_report("fan-in by CL_splice at the end", n, bench_now() - t);
+  CL_free(result);
+
+  for (int i = 0; i < n; i++)
+    for (int j = 0; j < each; j++)
+      CL_push(lists[i], keys[j]);
+
+  result = CL_new();
+  t = bench_now();
+  for (int i = 0; i < n; i++)
+    CL_join(result, lists[i]);
+  bench_report("fan-in by CL_join", n, bench_now() - t);
+
+  t = bench_now();
+  for (int i = 0; i < 100; i++)
+    count += CL_nth(result, i * (n * each / 100)) != NULL;
+  bench_report("100 CL_nth across the segments", n, bench_now() - t);
+  t = bench_now();
+  CL_foreach(result, bench_count, &count);
+  bench_report("CL_foreach across the segments", n, bench_now() - t);
+  t = bench_now();
+  CL_insert(result, keys[0], 1);
+  bench_report("first CL_insert, linking the segments", n, bench_now() - t);
+
+  if (count != 100 + n * each)
+    printf("  count mismatch!\n");
+  CL_free(result);
+  for (int i = 0; i < n; i++)
+    CL_free(lists[i]);
+  free(lists);
+  bench_free_keys(keys, each);
+}
+
+
+static void bench_finger(int n)
+{
+  const char **keys = bench_make_keys(n, "");
+  long count = 0;
+  double t;
+
+  CList list = CL_new();
+  t = bench_now();
+  for (int i = 0; i < n; i++)
+    CL_insert(list, keys[i], i);
+  bench_report("CL_insert at increasing positions", n, bench_now() - t);
+
+  // Reading position 0 between steps puts the finger back on the
+  // head, as if there were none
+  t = bench_now();
+  for (int i = 0; i < n; i++) {
+    count += CL_nth(list, 0) != NULL;
+    count += CL_nth(list, i) != NULL;
+  }
+  bench_report("CL_nth(i) from the head each time", n, bench_now() - t);
+  t = bench_now();
+  for (int i = 0; i < n; i++)
+    count += CL_nth(list, i) != NULL;
+  bench_report("CL_nth(i) in order, from the finger", n, bench_now() - t);
+  t = bench_now();
+  for (int i = 0; i < CL_length(list); i++)
+    CL_remove(list, i);
+  bench_report("CL_remove of every other element", n, bench_now() - t);
+
+  if (count != 3L * n)
+    printf("  count mismatch!\n");
+  CL_free(list);
+  bench_free_keys(keys, n);
+}
+
+
+// Predicate for CL_remove_if: keys starting with a letter before 'i'
+static bool bench_early(const char *element, void *cb_data)
+{
+  (void) cb_data;
+  return element[0] < 'i';
+}
+
+// CL_foreach callback collecting the positions bench_early selects
+static void bench_collect(int pos, const char *element, void *cb_data)
+{
+  int **tail = (int **) cb_data;
+  if (bench_early(element, NULL))
+    *(*tail)++ = pos;
+}
+
+static void bench_remove_if(int n)
+{
+  const char **keys = bench_make_keys(n, "");
+  int *hits = (int *) malloc(n * sizeof(int));
+  int removed[3] = {0, 0, 0};
+  double t;
+
+  // Positions found by CL_foreach, removed last first so that the
+  // earlier ones stay valid
+  CList list = CL_new();
+  for (int i = 0; i < n; i++)
+    CL_append(list, keys[i]);
+  t = bench_now();
+  int *tail = hits;
+  CL_foreach(list, bench_collect, &tail);
+  while (tail > hits) {
+    CL_remove(list, *--tail);
+    removed[0]++;
+  }
+  bench_report("CL_foreach, then CL_remove per hit", n, bench_now() - t);
+  CL_free(list);
+
+  list = CL_new();
+  for (int i = 0; i < n; i++)
+    CL_append(list, keys[i]);
+  t = bench_now();
+  for (int i = 0; i < CL_length(list); ) {
+    if (bench_early(CL_nth(list, i), NULL)) {
+      CL_remove(list, i);
+      removed[1]++;
+    } else {
+      i++;
+    }
+  }
+  bench_report("CL_nth/CL_remove in order", n, bench_now() - t);
+  CL_free(list);
+
+  list = CL_new();
+  for (int i = 0; i < n; i++)
+    CL_append(list, keys[i]);
+  t = bench_now();
+  removed[2] = CL_remove_if(list, bench_early, NULL);
+  bench_report("CL_remove_if", n, bench_now() - t);
+  CL_free(list);
+
+  if (removed[0] != removed[2] || removed[1] != removed[2])
+    printf("  count mismatch!\n");
+  free(hits);
+  bench_free_keys(keys, n);
+}
+
+
+// Copy a list for bench_radix, with its nodes laid out in list order
+// (compacted) or scattered over the heap, as a long-lived list's are
+static CList bench_radix_copy(CList list, const char **keys, int n,
+                              int scattered)
+{
+  if (!scattered) {
+    CList copy = CL_copy(list);
+    CL_compact(copy);
+    return copy;
+  }
+
+  // Free n nodes in an order unrelated to their addresses, for the
+  // copy to reuse
+  CList junk = CL_new();
+  for (int i = 0; i < n; i++)
+    CL_push(junk, keys[i]);
+  CL_sort(junk);
+  CL_free(junk);
+  return CL_copy(list);
+}
+
+static void bench_radix(int n)
+{
+  static const char *prefixes[] = {"", "https://example.com/users/"};
+  static const char *names[] = {"random keys", "26-byte prefix"};
+  static const char *layouts[] = {"compacted", "scattered"};
+  char what[80];
+  double t;
+
+  for (int k = 0; k < 2; k++) {
+    const char **keys = bench_make_keys(n, prefixes[k]);
+    CList list = CL_new();
+    for (int i = 0; i < n; i++)
+      CL_push(list, keys[i]);
+
+    for (int scattered = 0; scattered < 2; scattered++) {
+      CList copy = bench_radix_copy(list, keys, n, scattered);
+      t = bench_now();
+      CL_sort(copy);
+      snprintf(what, sizeof(what), "CL_sort, %s, %s", names[k],
+               layouts[scattered]);
+      bench_report(what, n, bench_now() - t);
+      CL_free(copy);
+
+      copy = bench_radix_copy(list, keys, n, scattered);
+      t = bench_now();
+      CL_sort_radix(copy);
+      snprintf(what, sizeof(what), "CL_sort_radix, %s, %s", names[k],
+               layouts[scattered]);
+      bench_report(what, n, bench_now() - t);
+      CL_free(copy);
+    }
+
+    CL_free(list);
+    bench_free_keys(keys, n);
+  }
+}
+
+
+// Elements per burst, and pause between bursts, of bench_queue's producer
+#define BENCH_BURST 64
+#define BENCH_BURST_GAP_US 200
+
+static void bench_sleep_us(long us)
+{
+  struct timespec ts = {us / 1000000, (us % 1000000) * 1000};
+  nanosleep(&ts, NULL);
+}
+
+// CPU time used by the calling thread, in seconds
+static double bench_thread_cpu()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+struct bench_producer {
+  const char **keys;
+  int n;
+  double *sent;                 // time each burst was added
+  CListQueue queue;             // NULL to use list and lock instead
+  CList list;
+  pthread_mutex_t *lock;
+};
+
+// Thread adding keys in bursts, to a queue or a locked list
+static void *bench_produce(void *arg)
+{
+  struct bench_producer *p = (struct bench_producer *) arg;
+  CList burst = CL_new();
+
+  for (int i = 0; i < p->n; ) {
+    p->sent[i / BENCH_BURST] = bench_now();
+    for (int j = 0; j < BENCH_BURST && i < p->n; j++)
+      CL_append(burst, p->keys[i++]);
+    if (p->queue != NULL) {
+      CLQ_append_all(p->queue, burst);
+    } else {
+      pthread_mutex_lock(p->lock);
+      CL_join(p->list, burst);
+      pthread_mutex_unlock(p->lock);
+    }
+    bench_sleep_us(BENCH_BURST_GAP_US);
+  }
+
+  CL_free(burst);
+  return NULL;
+}
+
+// Consumer's view of one bench_queue run
+struct bench_consumer {
+  double start_cpu;
+  double latency;               // total delay until a burst's first pop
+  long wakeups;                 // empty polls, or epoll_wait returns
+};
+
+// Note that the consumer has popped element got of the producer's
+static void bench_consumed(struct bench_producer *p, struct bench_consumer *c,
+                           int got)
+{
+  if (got % BENCH_BURST == 0)
+    c->latency += bench_now() - p->sent[got / BENCH_BURST];
+}
+
+static void bench_consumer_report(const char *what, struct bench_consumer *c,
+                                  int n)
+{
+  int bursts = (n + BENCH_BURST - 1) / BENCH_BURST;
+  printf("  %-40s latency %7.1f us, cpu %8.3f ms", what,
+         c->latency / bursts * 1e6, (bench_thread_cpu() - c->start_cpu) * 1e3);
+  if (c->wakeups > 0)
+    printf(", %ld wake-ups for %d bursts", c->wakeups, bursts);
+  printf("\n");
+}
+
+static void bench_queue(int n)
+{
+  const char **keys = bench_make_keys(n, "");
+  double *sent = (double *) malloc((n / BENCH_BURST + 1) * sizeof(double));
+  pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+  struct bench_producer p = {keys, n, sent, NULL, CL_new(), &lock};
+  struct bench_consumer c;
+  pthread_t producer;
+
+  // Polling: CL_pop under a lock, sleeping when the list is empty
+  c = (struct bench_consumer) {bench_thread_cpu(), 0.0, 0};
+  pthread_create(&producer, NULL, bench_produce, &p);
+  for (int got = 0; got < n; ) {
+    pthread_mutex_lock(&lock);
+    CListElementType elem = CL_pop(p.list);
+    pthread_mutex_unlock(&lock);
+    if (elem != INVALID_RETURN) {
+      bench_consumed(&p, &c, got++);
+    } else {
+      bench_sleep_us(BENCH_BURST_GAP_US / 4);
+      c.wakeups++;
+    }
+  }
+  bench_consumer_report("CL_pop, sleeping when empty", &c, n);
+  pthread_join(producer, NULL);
+
+  // Blocking in CLQ_pop_wait
+  p.queue = CLQ_new();
+  c = (struct bench_consumer) {bench_thread_cpu(), 0.0, 0};
+  pthread_create(&producer, NULL, bench_produce, &p);
+  for (int got = 0; got < n; ) {
+    CLQ_pop_wait(p.queue, -1);
+    bench_consumed(&p, &c, got++);
+  }
+  bench_consumer_report("CLQ_pop_wait", &c, n);
+  pthread_join(producer, NULL);
+  CLQ_free(p.queue);
+
+  // An event loop: epoll on the queue's descriptor, then CLQ_pop
+  p.queue = CLQ_new();
+  int epfd = epoll_create1(0);
+  struct epoll_event ev = {.events = EPOLLIN};
+  epoll_ctl(epfd, EPOLL_CTL_ADD, CLQ_fd(p.queue), &ev);
+  c = (struct bench_consumer) {bench_thread_cpu(), 0.0, 0};
+  pthread_create(&producer, NULL, bench_produce, &p);
+  for (int got = 0; got < n; ) {
+    epoll_wait(epfd, &ev, 1, -1);
+    c.wakeups++;
+    while (CLQ_pop(p.queue) != INVALID_RETURN)
+      bench_consumed(&p, &c, got++);
+  }
+  bench_consumer_report("epoll on CLQ_fd, then CLQ_pop", &c, n);
+  pthread_join(producer, NULL);
+  close(epfd);
+  CLQ_free(p.queue);
+
+  CL_free(p.list);
+  free(sent);
+  bench_free_keys(keys, n);
+}
+
+
+// Writes done by bench_rcu's writer, one every BENCH_RCU_GAP_US
+#define BENCH_RCU_WRITES 2000
+#define BENCH_RCU_GAP_US 100
+
+// bench_rcu's reader thread, scanning a list until told to stop
+struct bench_reader {
+  CList list;                   // scanned under lock, if not NULL
+  CListRCU rcu;                 // scanned without a lock otherwise
+  pthread_mutex_t *lock;
+  atomic_bool stop;
+  long scans;
+};
+
+static void *bench_read(void *arg)
+{
+  struct bench_reader *r = (struct bench_reader *) arg;
+
+  while (!atomic_load(&r->stop)) {
+    long count = 0;
+    if (r->list != NULL) {
+      pthread_mutex_lock(r->lock);
+      CL_foreach(r->list, bench_count, &count);
+      pthread_mutex_unlock(r->lock);
+    } else {
+      CLRCU_foreach(r->rcu, bench_count, &count);
+    }
+    r->scans++;
+  }
+  return NULL;
+}
+
+static int bench_compare_double(const void *a, const void *b)
+{
+  double x = *(const double *) a, y = *(const double *) b;
+  return (x > y) - (x < y);
+}
+
+// Print the median, 99th percentile and longest of the writer's
+// latencies, and the rate at which the reader scanned meanwhile
+static void bench_writer_report(const char *what, double *latency,
+                                struct bench_reader *r, double seconds)
+{
+  qsort(latency, BENCH_RCU_WRITES, sizeof(double), bench_compare_double);
+  printf("  %-32s write median %6.1f us, p99 %6.1f us, max %6.1f us; "
+         "%5.0f scans/s\n", what, latency[BENCH_RCU_WRITES / 2] * 1e6,
+         latency[BENCH_RCU_WRITES * 99 / 100] * 1e6,
+         latency[BENCH_RCU_WRITES - 1] * 1e6, r->scans / seconds);
+}
+
+/*
+ * Latency of a writer pushing and popping an element, while another
+ * thread scans an n-element list over and over: a CList with a lock
+ * held for each scan, against a CListRCU
+ */
+static void bench_rcu(int n)
+{
+  const char **keys = bench_make_keys(n, "");
+  pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+  double *latency = (double *) malloc(BENCH_RCU_WRITES * sizeof(double));
+  pthread_t reader;
+
+  struct bench_reader r = {CL_new(), NULL, &lock, false, 0};
+  for (int i = 0; i < n; i++)
+    CL_push(r.list, keys[i]);
+  double begin = bench_now();
+  pthread_create(&reader, NULL, bench_read, &r);
+  for (int i = 0; i < BENCH_RCU_WRITES; i++) {
+    bench_sleep_us(BENCH_RCU_GAP_US);
+    double start = bench_now();
+    pthread_mutex_lock(&lock);
+    CL_push(r.list, keys[i]);
+    CL_pop(r.list);
+    pthread_mutex_unlock(&lock);
+    latency[i] = bench_now() - start;
+  }
+  atomic_store(&r.stop, true);
+  pthread_join(reader, NULL);
+  bench_writer_report("CList, scans under a lock", latency, &r,
+                      bench_now() - begin);
+  CL_free(r.list);
+
+  r = (struct bench_reader) {NULL, CLRCU_new(), NULL, false, 0};
+  for (int i = 0; i < n; i++)
+    CLRCU_push(r.rcu, keys[i]);
+  begin = bench_now();
+  pthread_create(&reader, NULL, bench_read, &r);
+  for (int i = 0; i < BENCH_RCU_WRITES; i++) {
+    bench_sleep_us(BENCH_RCU_GAP_US);
+    double start = bench_now();
+    CLRCU_push(r.rcu, keys[i]);
+    CLRCU_pop(r.rcu);
+    latency[i] = bench_now() - start;
+  }
+  atomic_store(&r.stop, true);
+  pthread_join(reader, NULL);
+  bench_writer_report("CListRCU, scans without a lock", latency, &r,
+                      bench_now() - begin);
+  CLRCU_free(r.rcu);
+
+  free(latency);
+  bench_free_keys(keys, n);
+}
+
+
+// Threads appending in bench_shard
+#define BENCH_SHARD_THREADS 4
+
+// One of bench_shard's appending threads: appends keys[from, to) to a
+// locked CList, or to a sharded list
+struct bench_appender {
+  const char **keys;
+  int from, to;
+  CList list;
+  pthread_mutex_t *lock;
+  CListShards shards;
+};
+
+static void *bench_append(void *arg)
+{
+  struct bench_appender *a = (struct bench_appender *) arg;
+
+  for (int i = a->from; i < a->to; i++) {
+    if (a->shards != NULL) {
+      CLS_append(a->shards, a->keys[i]);
+    } else {
+      pthread_mutex_lock(a->lock);
+      CL_append(a->list, a->keys[i]);
+      pthread_mutex_unlock(a->lock);
+    }
+  }
+  return NULL;
+}
+
+// Run bench_append on BENCH_SHARD_THREADS threads, each appending an
+// equal share of n keys, and return the time taken
+static double bench_append_threads(struct bench_appender a, int n)
+{
+  pthread_t threads[BENCH_SHARD_THREADS];
+  struct bench_appender each[BENCH_SHARD_THREADS];
+
+  double start = bench_now();
+  for (int t = 0; t < BENCH_SHARD_THREADS; t++) {
+    each[t] = a;
+    each[t].from = (int) ((long) n * t / BENCH_SHARD_THREADS);
+    each[t].to = (int) ((long) n * (t + 1) / BENCH_SHARD_THREADS);
+    pthread_create(&threads[t], NULL, bench_append, &each[t]);
+  }
+  for (int t = 0; t < BENCH_SHARD_THREADS; t++)
+    pthread_join(threads[t], NULL);
+  return bench_now() - start;
+}
+
+/*
+ * Several threads appending n elements between them to one CList
+ * behind a lock, against a CListShards with a shard per thread; then
+ * gathering the elements into one list, in any order and sorted
+ */
+static void bench_shard(int n)
+{
+  const char **keys = bench_make_keys(n, "");
+  pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+  struct bench_appender a = {keys, 0, 0, CL_new(), &lock, NULL};
+  struct bench_appender warm = {keys, 0, 0, NULL, NULL,
+                                CLS_new(BENCH_SHARD_THREADS)};
+  double start;
+
+  // A round of both beforehand, so that each finds the heap holding
+  // the same freed nodes
+  bench_append_threads(a, n);
+  bench_append_threads(warm, n);
+  CL_free(a.list);
+  CLS_free(warm.shards);
+
+  // The appends are timed first, each freed before the other, as the
+  // sorts leave the heap in a state that slows later appends
+  a.list = CL_new();
+  bench_report("CL_append under a lock, 4 threads", n,
+               bench_append_threads(a, n));
+  CL_free(a.list);
+
+  struct bench_appender sharded = {keys, 0, 0, NULL, NULL,
+                                   CLS_new(BENCH_SHARD_THREADS)};
+  bench_report("CLS_append, 4 threads, 4 shards", n,
+               bench_append_threads(sharded, n));
+  start = bench_now();
+  CList list = CLS_collect(sharded.shards);
+  bench_report("CLS_collect", n, bench_now() - start);
+  CL_free(list);
+
+  a.list = CL_new();
+  bench_append_threads(a, n);
+  start = bench_now();
+  CL_sort_radix(a.list);
+  bench_report("CL_sort_radix of one locked list", n, bench_now() - start);
+  CL_free(a.list);
+
+  bench_append_threads(sharded, n);
+  start = bench_now();
+  list = CLS_collect_sorted(sharded.shards);
+  bench_report("CLS_collect_sorted", n, bench_now() - start);
+  CL_free(list);
+  CLS_free(sharded.shards);
+
+  bench_free_keys(keys, n);
+}
+
+
+// Threads copying in bench_copy
+#define BENCH_COPY_THREADS 4
+
+/*
+ * Copying and freeing a long list whose nodes are scattered by sorts:
+ * CL_copy against CL_copy_parallel, of a single chain and of a list
+ * joined from one sorted list per thread; and CL_free against handing
+ * the list to CL_free_deferred
+ */
+static void bench_copy(int n)
+{
+  const char **keys = bench_make_keys(n, "");
+  long count = 0;
+  double t;
+
+  CList list = CL_new();
+  for (int i = 0; i < n; i++)
+    CL_append(list, keys[i]);
+  CL_sort(list);
+
+  t = bench_now();
+  CList copy = CL_copy(list);
+  bench_report("CL_copy", n, bench_now() - t);
+  t = bench_now();
+  CL_foreach(copy, bench_count, &count);
+  bench_report("scan of that copy", n, bench_now() - t);
+  t = bench_now();
+  CL_free(copy);
+  bench_report("CL_free of that copy", n, bench_now() - t);
+
+  t = bench_now();
+  copy = CL_copy_parallel(list, BENCH_COPY_THREADS);
+  bench_report("CL_copy_parallel, one chain", n, bench_now() - t);
+  t = bench_now();
+  CL_foreach(copy, bench_count, &count);
+  bench_report("scan of that copy", n, bench_now() - t);
+  CL_free(copy);
+
+  // The same nodes, as one sorted list per thread joined together
+  CList joined = CL_new();
+  for (int t = 0; t < BENCH_COPY_THREADS; t++) {
+    CList part = CL_split(list, CL_length(list) / (BENCH_COPY_THREADS - t));
+    CL_sort(list);
+    CL_join(joined, list);
+    CL_free(list);
+    list = part;
+  }
+  CL_free(list);
+  list = joined;
+
+  t = bench_now();
+  copy = CL_copy(list);
+  bench_report("CL_copy, joined", n, bench_now() - t);
+  CL_free(copy);
+  t = bench_now();
+  copy = CL_copy_parallel(list, BENCH_COPY_THREADS);
+  bench_report("CL_copy_parallel, joined, 4 threads", n, bench_now() - t);
+  CL_free(copy);
+
+  t = bench_now();
+  CL_free_deferred(list);
+  bench_report("CL_free_deferred of the original", n, bench_now() - t);
+  t = bench_now();
+  CL_free_wait();
+  bench_report("CL_free_wait for it", n, bench_now() - t);
+
+  bench_free_keys(keys, n);
+}
+
+
+struct benchmark {
+  const char *name;
+  void (*run)(int n);
+  int default_n;
+};
+
+static const struct benchmark benchmarks[] = {
+  {"merge", bench_merge, 10000},
+  {"setops", bench_setops, 10000},
+  {"kway", bench_kway, 20000},
+  {"compact", bench_compact, 1000000},
+  {"scattered", bench_scattered, 4000000},
+  {"compaction", bench_compaction, 4000000},
+  {"strcmp", bench_strcmp, 200000},
+  {"dedup", bench_dedup, 20000},
+  {"pq", bench_pq, 100000},
+  {"ring", bench_ring, 1000000},
+  {"foreach", bench_foreach, 4000000},
+  {"join", bench_join, 10000},
+  {"finger", bench_finger, 20000},
+  {"remove_if", bench_remove_if, 20000},
+  {"queue", bench_queue, 64000},
+  {"radix", bench_radix, 1000000},
+  {"rcu", bench_rcu, 100000},
+  {"shard", bench_shard, 1000000},
+  {"copy", bench_copy, 4000000},
+};
+
+static const int num_benchmarks = sizeof(benchmarks) / sizeof(benchmarks[0]);
+
+
+int main(int argc, char *argv[])
+{
+  const char *only = (argc > 1) ? argv[1] : NULL;
+  int n = (argc > 2) ? atoi(argv[2]) : 0;
+  int ran = 0;
+
+  for (int i = 0; i < num_benchmarks; i++) {
+    if (only != NULL && strcmp(only, benchmarks[i].name) != 0)
+      continue;
+    printf("%s:\n", benchmarks[i].name);
+    benchmarks[i].run(n > 0 ? n : benchmarks[i].default_n);
+    ran++;
+  }
+
+  if (ran == 0) {
+    fprintf(stderr, "Unknown benchmark '%s'\n", only);
+    return 1;
+  }
+
+#ifdef CL_TRACE
+  if (!CLT_save("clist_bench.trace")) {
+    fprintf(stderr, "Can not write clist_bench.trace\n");
+    return 1;
+  }
+#endif
+  return 0;
+}
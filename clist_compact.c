@@ -0,0 +1,434 @@
+/*
+ * clist_compact.c
+ *
+ * Compact linked list, stored in a growable node array with 32-bit
+ * next indices
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <assert.h>
+#include <string.h>
+
+#include "clist_compact.h"
+
+// Index used as the NULL link
+#define CLC_NIL UINT32_MAX
+
+// Capacity of the node arrays when the first node is added
+#define CLC_MIN_CAPACITY 16
+
+struct _cl_compact {
+  CListElementType *elements;   // element stored in each slot
+  uint32_t *next;               // next slot of each slot, or CLC_NIL
+  uint32_t capacity;            // number of slots allocated
+  uint32_t used;                // slots [0, used) have been handed out
+  uint32_t free_slot;           // first slot on the free chain, or CLC_NIL
+  uint32_t head;
+  uint32_t tail;
+  uint32_t length;
+};
+
+
+
+/*
+ * Make room for at least one more slot, doubling the node arrays.
+ * A compact list holds at most INT_MAX elements; growing past that
+ * aborts the program with a message, in builds with and without
+ * NDEBUG alike, as there is no slot to return.
+ *
+ * Parameters:
+ *   list     The list
+ *
+ * Returns: None
+ */
+static void
+_CLC_grow(CListCompact list)
+{
+  if (list->capacity >= INT_MAX) {
+    fprintf(stderr, "CListCompact: more than %d elements\n", INT_MAX);
+    abort();
+  }
+
+  uint32_t capacity = list->capacity ? list->capacity * 2 : CLC_MIN_CAPACITY;
+  if (capacity > INT_MAX)
+    capacity = INT_MAX;
+
+  list->elements = (CListElementType *)
+    realloc(list->elements, capacity * sizeof(*list->elements));
+  list->next = (uint32_t *) realloc(list->next, capacity * sizeof(*list->next));
+  assert(list->elements);
+  assert(list->next);
+
+  list->capacity = capacity;
+}
+
+
+
+/*
+ * Take a slot for a new node, from the free chain if possible, and
+ * populate it with the supplied values
+ *
+ * Parameters:
+ *   list           The list
+ *   element, next  The values for the node to be created
+ *
+ * Returns: The index of the new node
+ */
+static uint32_t
+_CLC_new_node(CListCompact list, CListElementType element, uint32_t next)
+{
+  uint32_t slot = list->free_slot;
+
+  if (slot != CLC_NIL) {
+    list->free_slot = list->next[slot];
+  } else {
+    if (list->used == list->capacity)
+      _CLC_grow(list);
+    slot = list->used++;
+  }
+
+  list->elements[slot] = element;
+  list->next[slot] = next;
+  list->length++;
+
+  return slot;
+}
+
+
+
+/*
+ * Return a node's slot to the free chain
+ *
+ * Parameters:
+ *   list     The list
+ *   slot     The index of the node
+ *
+ * Returns: None
+ */
+static void
+_CLC_free_node(CListCompact list, uint32_t slot)
+{
+  list->next[slot] = list->free_slot;
+  list->free_slot = slot;
+  list->length--;
+}
+
+
+
+/*
+ * Find the node at a position of the list
+ *
+ * Parameters:
+ *   list     The list
+ *   pos      The position, in the range [0, length-1]
+ *
+ * Returns: The index of the node
+ */
+static uint32_t
+_CLC_node_at(CListCompact list, int pos)
+{
+  if ((uint32_t) pos == list->length - 1)
+    return list->tail;
+
+  uint32_t slot = list->head;
+  for (int i = 0; i < pos; i++)
+    slot = list->next[slot];
+  return slot;
+}
+
+
+
+// Documented in .h file
+CListCompact CLC_new()
+{
+  CListCompact list = (CListCompact) malloc(sizeof(struct _cl_compact));
+  assert(list);
+
+  list->elements = NULL;
+  list->next = NULL;
+  list->capacity = 0;
+  list->used = 0;
+  list->free_slot = CLC_NIL;
+  list->head = CLC_NIL;
+  list->tail = CLC_NIL;
+  list->length = 0;
+
+  return list;
+}
+
+
+
+// Adds each element of a CList to the compact list in cb_data
+static void
+_CLC_append_cb(int pos, CListElementType element, void *cb_data)
+{
+  (void) pos;
+  CLC_append((CListCompact) cb_data, element);
+}
+
+
+
+// Documented in .h file
+CListCompact CLC_from_list(CList src_list)
+{
+  assert(src_list);
+
+  CListCompact list = CLC_new();
+  CL_foreach(src_list, _CLC_append_cb, list);
+
+  return list;
+}
+
+
+
+// Documented in .h file
+void CLC_free(CListCompact list)
+{
+  if (list == NULL) return;
+
+  free(list->elements);
+  free(list->next);
+  free(list);
+}
+
+
+
+// Documented in .h file
+int CLC_length(CListCompact list)
+{
+  assert(list);
+#ifndef NDEBUG
+  // As for CL_length, walk the list to check the stored length
+  uint32_t len = 0;
+  for (uint32_t slot = list->head; slot != CLC_NIL; slot = list->next[slot])
+    len++;
+
+  assert(len == list->length);
+#endif
+
+  return (int) list->length;
+}
+
+
+
+// Documented in .h file
+void CLC_print(CListCompact list)
+{
+  assert(list);
+
+  int num = 0;
+  for (uint32_t slot = list->head; slot != CLC_NIL; slot = list->next[slot])
+    printf("  [%d]: %s\n", num++, list->elements[slot]);
+}
+
+
+
+// Documented in .h file
+void CLC_push(CListCompact list, CListElementType element)
+{
+  assert(list);
+
+  list->head = _CLC_new_node(list, element, list->head);
+  if (list->tail == CLC_NIL)
+    list->tail = list->head;
+}
+
+
+
+// Documented in .h file
+CListElementType CLC_pop(CListCompact list)
+{
+  assert(list);
+
+  uint32_t slot = list->head;
+  if (slot == CLC_NIL)
+    return INVALID_RETURN;
+
+  CListElementType ret = list->elements[slot];
+  list->head = list->next[slot];
+  if (list->head == CLC_NIL)
+    list->tail = CLC_NIL;
+  _CLC_free_node(list, slot);
+
+  return ret;
+}
+
+
+
+// Documented in .h file
+void CLC_append(CListCompact list, CListElementType element)
+{
+  assert(list);
+
+  uint32_t slot = _CLC_new_node(list, element, CLC_NIL);
+  if (list->tail == CLC_NIL)
+    list->head = slot;
+  else
+    list->next[list->tail] = slot;
+  list->tail = slot;
+}
+
+
+
+// Documented in .h file
+CListElementType CLC_nth(CListCompact list, int pos)
+{
+  assert(list);
+
+  if (pos < 0)
+    pos += (int) list->length;  // Handle negative indices
+  if (pos < 0 || (uint32_t) pos >= list->length)
+    return INVALID_RETURN;  // Out of range
+
+  return list->elements[_CLC_node_at(list, pos)];
+}
+
+
+
+// Documented in .h file
+bool CLC_insert(CListCompact list, CListElementType element, int pos)
+{
+  assert(list);
+
+  if (pos < 0)
+    pos = (int) list->length + pos + 1;  // Convert negative index to positive
+  if (pos < 0 || (uint32_t) pos > list->length)
+    return false;  // Out of range
+
+  if (pos == 0) {
+    CLC_push(list, element);
+  } else if ((uint32_t) pos == list->length) {
+    CLC_append(list, element);
+  } else {
+    uint32_t prev = _CLC_node_at(list, pos - 1);
+    uint32_t slot = _CLC_new_node(list, element, list->next[prev]);
+    list->next[prev] = slot;
+  }
+  return true;
+}
+
+
+
+// Documented in .h file
+CListElementType CLC_remove(CListCompact list, int pos)
+{
+  assert(list);
+
+  if (pos < 0)
+    pos += (int) list->length;  // Convert negative index to positive
+  if (pos < 0 || (uint32_t) pos >= list->length)
+    return INVALID_RETURN;  // Out of range
+
+  if (pos == 0)
+    return CLC_pop(list);
+
+  uint32_t prev = _CLC_node_at(list, pos - 1);
+  uint32_t slot = list->next[prev];
+  CListElementType ret = list->elements[slot];
+
+  list->next[prev] = list->next[slot];
+  if (slot == list->tail)
+    list->tail = prev;
+  _CLC_free_node(list, slot);
+
+  return ret;
+}
+
+
+
+// Documented in .h file
+CListCompact CLC_copy(CListCompact src_list)
+{
+  assert(src_list);
+
+  CListCompact list = CLC_new();
+  for (uint32_t slot = src_list->head; slot != CLC_NIL;
+       slot = src_list->next[slot])
+    CLC_append(list, src_list->elements[slot]);
+
+  return list;
+}
+
+
+
+// Documented in .h file
+int CLC_insert_sorted(CListCompact list, CListElementType element)
+{
+  assert(list);
+
+  // Walk past every element that sorts before or equal to the new one
+  uint32_t prev = CLC_NIL;
+  uint32_t slot = list->head;
+  int pos = 0;
+  while (slot != CLC_NIL && CL_strcmp(list->elements[slot], element) <= 0) {
+    prev = slot;
+    slot = list->next[slot];
+    pos++;
+  }
+
+  uint32_t new_slot = _CLC_new_node(list, element, slot);
+  if (prev == CLC_NIL)
+    list->head = new_slot;
+  else
+    list->next[prev] = new_slot;
+  if (slot == CLC_NIL)
+    list->tail = new_slot;
+
+  return pos;
+}
+
+
+
+// Documented in .h file
+void CLC_join(CListCompact list1, CListCompact list2)
+{
+  assert(list1);
+  assert(list2);
+  assert(list1 != list2);
+
+  for (uint32_t slot = list2->head; slot != CLC_NIL; slot = list2->next[slot])
+    CLC_append(list1, list2->elements[slot]);
+
+  // Empty list2, keeping its arrays for reuse
+  list2->used = 0;
+  list2->free_slot = CLC_NIL;
+  list2->head = CLC_NIL;
+  list2->tail = CLC_NIL;
+  list2->length = 0;
+}
+
+
+
+// Documented in .h file
+void CLC_reverse(CListCompact list)
+{
+  assert(list);
+
+  uint32_t prev = CLC_NIL;
+  uint32_t slot = list->head;
+
+  list->tail = slot;
+  while (slot != CLC_NIL) {
+    uint32_t next = list->next[slot];
+    list->next[slot] = prev;
+    prev = slot;
+    slot = next;
+  }
+  list->head = prev;
+}
+
+
+
+// Documented in .h file
+void CLC_foreach(CListCompact list, CL_foreach_callback callback,
+    void *cb_data)
+{
+  assert(list);
+
+  int pos = 0;
+  for (uint32_t slot = list->head; slot != CLC_NIL; slot = list->next[slot])
+    callback(pos++, list->elements[slot], cb_data);
+}
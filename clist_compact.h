@@ -0,0 +1,102 @@
+/*
+ * clist_compact.h
+ *
+ * Compact linked list: a CList stored in a growable array of nodes,
+ * linked by 32-bit indices instead of pointers.
+ *
+ * Each element costs 12 bytes (the element and a 32-bit next index,
+ * kept in two parallel arrays) instead of a separately malloc'd
+ * 24-byte node, and nodes added in order sit next to each other in
+ * memory, which makes traversal friendly to the hardware prefetcher.
+ * A compact list holds at most INT_MAX elements; adding one more
+ * aborts the program.
+ *
+ * Every function behaves exactly like its CL_ counterpart in clist.h.
+ */
+
+#ifndef _CLIST_COMPACT_H_
+#define _CLIST_COMPACT_H_
+
+#include <stdbool.h>
+
+#include "clist.h"
+
+// struct _cl_compact is defined in .c file
+typedef struct _cl_compact *CListCompact;
+
+
+/*
+ * Create a new, empty compact list
+ *
+ * Parameters: None
+ *
+ * Returns: The new list
+ */
+CListCompact CLC_new();
+
+
+/*
+ * Create a new compact list holding the elements of a CList, in the
+ * same order. The nodes are laid out contiguously in list order.
+ *
+ * Parameters:
+ *   list     The list to copy
+ *
+ * Returns: The new list
+ */
+CListCompact CLC_from_list(CList list);
+
+
+/*
+ * Destroy a compact list, calling free() on all malloc'd memory.
+ *
+ * Parameters:
+ *   list   The list; if NULL, no action will occur
+ *
+ * Returns: None
+ */
+void CLC_free(CListCompact list);
+
+
+// As CL_length
+int CLC_length(CListCompact list);
+
+// As CL_print
+void CLC_print(CListCompact list);
+
+// As CL_push
+void CLC_push(CListCompact list, CListElementType element);
+
+// As CL_pop
+CListElementType CLC_pop(CListCompact list);
+
+// As CL_append; runs in constant time
+void CLC_append(CListCompact list, CListElementType element);
+
+// As CL_nth
+CListElementType CLC_nth(CListCompact list, int pos);
+
+// As CL_insert
+bool CLC_insert(CListCompact list, CListElementType element, int pos);
+
+// As CL_remove
+CListElementType CLC_remove(CListCompact list, int pos);
+
+// As CL_copy; the copy's nodes are laid out contiguously in list order
+CListCompact CLC_copy(CListCompact src_list);
+
+// As CL_insert_sorted
+int CLC_insert_sorted(CListCompact list, CListElementType element);
+
+// As CL_join; the nodes of list2 are copied into list1's array
+void CLC_join(CListCompact list1, CListCompact list2);
+
+// As CL_reverse
+void CLC_reverse(CListCompact list);
+
+// As CL_foreach
+void CLC_foreach(CListCompact list, CL_foreach_callback callback,
+    void *cb_data);
+
+
+#endif /* _CLIST_COMPACT_H_ */
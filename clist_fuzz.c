@@ -0,0 +1,848 @@
+/*
+ * clist_fuzz.c
+ *
+ * Randomized differential test for CLists. Random sequences of the
+ * operations in clist.h are applied both to CLists and to a simple
+ * array model of them; every result, and the full contents of the
+ * lists, are checked against the model after each operation. The time
+ * spent in each CList operation is recorded, so that a change to the
+ * list implementation can be validated and profiled under the same
+ * driver.
+ *
+ * Build with "make fuzz", which compiles with the sanitizer and the
+ * DEBUG consistency checks in clist.c.
+ *
+ * Usage: ./clist_fuzz [num_ops [seed]]
+ *
+ * Built with -DCL_FUZZ_LIBFUZZER, the file instead provides the
+ * libFuzzer entry point, which reads the operations from the fuzzer's
+ * input ("make fuzz-libfuzzer", which needs clang).
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include "./clist.h"
+
+// Lists longer than this are emptied, to keep the linear-time
+// operations and checks cheap
+#define FUZZ_MAX_LENGTH 1024
+
+// Contents of the elements. Some are equal strings, which are stored
+// at different addresses: the checks compare addresses, so they also
+// see whether equal elements are kept in the right order. Others
+// exercise the cached keys: strings shorter than, exactly and longer
+// than 8 bytes, long shared prefixes, and bytes above 0x7f.
+static const char *fuzz_strings[] = {
+  "", "a", "b", "b", "ab", "abc", "abc", "zulu", "Zulu",
+  "abcdefg", "abcdefgh", "abcdefgh", "abcdefgi", "abcdefghi",
+  "shared-prefix-0001", "shared-prefix-0002", "shared-prefix-0002",
+  "shared-prefix-00021", "\x7f", "\xff",
+};
+
+#define FUZZ_NUM_ELEMENTS (int) (sizeof(fuzz_strings) / sizeof(fuzz_strings[0]))
+
+static char *fuzz_elements[FUZZ_NUM_ELEMENTS];
+
+
+// The operations, each timed separately
+enum {
+  OP_PUSH, OP_POP, OP_APPEND, OP_NTH, OP_NTH_Z, OP_INSERT, OP_INSERT_Z,
+  OP_REMOVE, OP_REMOVE_Z, OP_COPY, OP_JOIN, OP_REVERSE, OP_FOREACH,
+  OP_FOREACH_Z, OP_FOREACH_BATCH, OP_FOR_EACH, OP_SORT, OP_SORT_RADIX,
+  OP_INSERT_SORTED,
+  OP_FIND_SORTED, OP_MERGE_SORTED, OP_INTERSECT_SORTED,
+  OP_DIFFERENCE_SORTED, OP_MERGE_SORTED_K, OP_UNIQUE, OP_DEDUP, OP_REMOVE_IF,
+  OP_EXTRACT_IF, OP_SPLIT,
+  OP_SPLICE, OP_SLICE, OP_COMPACT, OP_AUTO_COMPACT, OP_SET_KEY, OP_CLEAR,
+  NUM_OPS
+};
+
+static const char *fuzz_op_names[NUM_OPS] = {
+  "CL_push", "CL_pop", "CL_append", "CL_nth", "CL_nth_z", "CL_insert",
+  "CL_insert_z", "CL_remove", "CL_remove_z", "CL_copy", "CL_join",
+  "CL_reverse", "CL_foreach", "CL_foreach_z", "CL_foreach_batch",
+  "CL_FOR_EACH", "CL_sort", "CL_sort_radix", "CL_insert_sorted",
+  "CL_find_sorted", "CL_merge_sorted", "CL_intersect_sorted",
+  "CL_difference_sorted", "CL_merge_sorted_k", "CL_unique", "CL_dedup",
+  "CL_remove_if", "CL_extract_if", "CL_split", "CL_splice", "CL_slice",
+  "CL_compact", "CL_set_auto_compact", "CL_set_key",
+  "CL_free/CL_new",
+};
+
+// Number of calls and time spent in each operation
+static unsigned long fuzz_counts[NUM_OPS];
+static double fuzz_seconds[NUM_OPS];
+
+// Operation being run, for failure reports
+static unsigned long fuzz_num_ops;
+static int fuzz_op;
+
+
+// Current time in seconds, from a monotonic clock
+static double fuzz_now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Run stmt, adding its time to the current operation
+#define FUZZ_TIME(stmt) do {                                            \
+    double start_ = fuzz_now();                                         \
+    stmt;                                                               \
+    fuzz_seconds[fuzz_op] += fuzz_now() - start_;                       \
+  } while (0)
+
+// Report a mismatch between a list and its model, and stop
+static void fuzz_fail(const char *what, int line)
+{
+  fprintf(stderr, "FAIL line %d, operation %lu (%s): %s\n", line,
+          fuzz_num_ops, fuzz_op_names[fuzz_op], what);
+  abort();
+}
+
+#define fuzz_check(cond) do {                                           \
+    if (!(cond))                                                        \
+      fuzz_fail(#cond, __LINE__);                                       \
+  } while (0)
+
+
+/*
+ * Source of the random choices: a fuzzer's input, or an xorshift
+ * generator when data is NULL
+ */
+struct fuzz_input {
+  const uint8_t *data;
+  size_t size;
+  size_t pos;
+  uint64_t state;
+};
+
+static unsigned fuzz_byte(struct fuzz_input *in)
+{
+  if (in->data != NULL)
+    return (in->pos < in->size) ? in->data[in->pos++] : 0;
+
+  in->state ^= in->state << 13;
+  in->state ^= in->state >> 7;
+  in->state ^= in->state << 17;
+  return (unsigned) (in->state >> 24) & 0xff;
+}
+
+static bool fuzz_done(struct fuzz_input *in)
+{
+  return in->data != NULL && in->pos >= in->size;
+}
+
+// A random number in [0, n)
+static int fuzz_below(struct fuzz_input *in, int n)
+{
+  unsigned r = fuzz_byte(in);
+  r |= fuzz_byte(in) << 8;
+  return (int) (r % (unsigned) n);
+}
+
+// A random position for a list of the given length, sometimes
+// negative and sometimes out of range
+static int fuzz_pos(struct fuzz_input *in, size_t length)
+{
+  int span = (int) length + 2;
+  return fuzz_below(in, 2 * span + 1) - span;
+}
+
+static const char *fuzz_element(struct fuzz_input *in)
+{
+  return fuzz_elements[fuzz_below(in, FUZZ_NUM_ELEMENTS)];
+}
+
+
+// Array model of a list
+struct model {
+  const char **items;
+  size_t length;
+  size_t capacity;
+};
+
+static void model_insert(struct model *m, size_t pos, const char *element)
+{
+  if (m->length == m->capacity) {
+    m->capacity = m->capacity ? 2 * m->capacity : 16;
+    m->items = (const char **) realloc(m->items, m->capacity * sizeof(char *));
+    if (m->items == NULL) abort();
+  }
+  memmove(&m->items[pos + 1], &m->items[pos],
+          (m->length - pos) * sizeof(char *));
+  m->items[pos] = element;
+  m->length++;
+}
+
+static const char *model_remove(struct model *m, size_t pos)
+{
+  const char *element = m->items[pos];
+  memmove(&m->items[pos], &m->items[pos + 1],
+          (m->length - pos - 1) * sizeof(char *));
+  m->length--;
+  return element;
+}
+
+// Convert a position following the rules for CL_nth; returns false
+// if it is out of range
+static bool model_nth_pos(struct model *m, ptrdiff_t pos, size_t *at)
+{
+  if (pos < 0)
+    pos += (ptrdiff_t) m->length;
+  if (pos < 0 || pos >= (ptrdiff_t) m->length)
+    return false;
+  *at = (size_t) pos;
+  return true;
+}
+
+// As model_nth_pos, following the rules for CL_insert
+static bool model_insert_pos(struct model *m, ptrdiff_t pos, size_t *at)
+{
+  if (pos < 0)
+    pos += (ptrdiff_t) m->length + 1;
+  if (pos < 0 || pos > (ptrdiff_t) m->length)
+    return false;
+  *at = (size_t) pos;
+  return true;
+}
+
+static bool model_is_sorted(struct model *m)
+{
+  for (size_t i = 1; i < m->length; i++)
+    if (strcmp(m->items[i - 1], m->items[i]) > 0)
+      return false;
+  return true;
+}
+
+// Stable sort by strcmp, as CL_sort
+static void model_sort(struct model *m)
+{
+  for (size_t i = 1; i < m->length; i++) {
+    const char *element = m->items[i];
+    size_t j = i;
+    for (; j > 0 && strcmp(m->items[j - 1], element) > 0; j--)
+      m->items[j] = m->items[j - 1];
+    m->items[j] = element;
+  }
+}
+
+// Append the items of from to m, leaving from empty
+static void model_join(struct model *m, struct model *from)
+{
+  for (size_t i = 0; i < from->length; i++)
+    model_insert(m, m->length, from->items[i]);
+  from->length = 0;
+}
+
+
+// Progress of an iteration through a list, checked against its model
+struct fuzz_walk {
+  struct model *m;
+  size_t offset;    // position in the model of the first element visited
+  size_t seen;
+  bool ok;
+};
+
+static void fuzz_visit(int pos, const char *element, void *cb_data)
+{
+  struct fuzz_walk *walk = (struct fuzz_walk *) cb_data;
+  size_t at = walk->offset + walk->seen;
+  if ((size_t) pos != walk->seen || at >= walk->m->length
+      || element != walk->m->items[at])
+    walk->ok = false;
+  walk->seen++;
+}
+
+static void fuzz_visit_z(size_t pos, const char *element, void *cb_data)
+{
+  fuzz_visit((int) pos, element, cb_data);
+}
+
+static void fuzz_visit_batch(int pos, const CListElementType *elements,
+    int count, void *cb_data)
+{
+  struct fuzz_walk *walk = (struct fuzz_walk *) cb_data;
+  if ((size_t) pos != walk->seen || count < 1 || count > CL_FOREACH_BATCH)
+    walk->ok = false;
+  for (int i = 0; i < count; i++)
+    fuzz_visit(pos + i, elements[i], cb_data);
+}
+
+
+// Check a list against its model, element by element. This streams
+// through the list with CL_foreach_z, which leaves segments recorded
+// by CL_join unlinked, so later operations see them.
+static void fuzz_check_list(CList list, struct model *m)
+{
+  fuzz_check( CL_length_z(list) == m->length );
+  fuzz_check( CL_length(list) == (int) m->length );
+
+  struct fuzz_walk walk = {m, 0, 0, true};
+  CL_foreach_z(list, fuzz_visit_z, &walk);
+  fuzz_check( walk.ok && walk.seen == m->length );
+}
+
+
+// Sort a list and its model, if the model is not sorted already, so
+// that the sorted operations can be applied
+static void fuzz_make_sorted(CList list, struct model *m)
+{
+  if (!model_is_sorted(m)) {
+    CL_sort(list);
+    model_sort(m);
+  }
+}
+
+// Predicate for CL_remove_if: elements whose first byte is below the
+// char cb_data points to
+static bool fuzz_select(CListElementType element, void *cb_data)
+{
+  return (unsigned char) element[0] < *(unsigned char *) cb_data;
+}
+
+// Pick the comparator for a sorted operation: NULL for the function
+// without _cmp, otherwise strcmp or CL_strcmp
+static CL_compare_fn fuzz_cmp(struct fuzz_input *in)
+{
+  switch (fuzz_byte(in) % 3) {
+  case 0: return NULL;
+  case 1: return strcmp;
+  default: return CL_strcmp;
+  }
+}
+
+// As _CL_filter_sorted in clist.c: remove from m1 the items that do
+// (keep_matches false) or do not (true) match an item of m2
+static void model_filter_sorted(struct model *m1, struct model *m2,
+    bool keep_matches)
+{
+  size_t i = 0, j = 0;
+  while (i < m1->length) {
+    int c = (j == m2->length) ? -1 : strcmp(m1->items[i], m2->items[j]);
+    if (c > 0) {
+      j++;
+      continue;
+    }
+    if (c == 0)
+      j++;
+    if ((c == 0) == keep_matches)
+      i++;
+    else
+      model_remove(m1, i);
+  }
+}
+
+
+/*
+ * Apply one random operation to one of the lists, or to both, and
+ * check the results against the models
+ *
+ * Returns: None
+ */
+static void fuzz_step(struct fuzz_input *in, CList lists[2],
+    struct model models[2])
+{
+  int t = fuzz_byte(in) & 1;
+  CList list = lists[t];
+  CList other = lists[1 - t];
+  struct model *m = &models[t];
+  struct model *mo = &models[1 - t];
+  size_t at;
+
+  fuzz_op = fuzz_below(in, NUM_OPS);
+  fuzz_counts[fuzz_op]++;
+
+  switch (fuzz_op) {
+  case OP_PUSH: {
+    const char *e = fuzz_element(in);
+    FUZZ_TIME(CL_push(list, e));
+    model_insert(m, 0, e);
+    break;
+  }
+
+  case OP_POP: {
+    CListElementType got;
+    FUZZ_TIME(got = CL_pop(list));
+    fuzz_check( got == (m->length ? model_remove(m, 0) : INVALID_RETURN) );
+    break;
+  }
+
+  case OP_APPEND: {
+    const char *e = fuzz_element(in);
+    FUZZ_TIME(CL_append(list, e));
+    model_insert(m, m->length, e);
+    break;
+  }
+
+  case OP_NTH:
+  case OP_NTH_Z: {
+    int pos = fuzz_pos(in, m->length);
+    CListElementType got;
+    if (fuzz_op == OP_NTH)
+      FUZZ_TIME(got = CL_nth(list, pos));
+    else
+      FUZZ_TIME(got = CL_nth_z(list, pos));
+    fuzz_check( got == (model_nth_pos(m, pos, &at) ? m->items[at]
+                        : INVALID_RETURN) );
+    break;
+  }
+
+  case OP_INSERT:
+  case OP_INSERT_Z: {
+    int pos = fuzz_pos(in, m->length);
+    const char *e = fuzz_element(in);
+    bool ok;
+    if (fuzz_op == OP_INSERT)
+      FUZZ_TIME(ok = CL_insert(list, e, pos));
+    else
+      FUZZ_TIME(ok = CL_insert_z(list, e, pos));
+    fuzz_check( ok == model_insert_pos(m, pos, &at) );
+    if (ok)
+      model_insert(m, at, e);
+    break;
+  }
+
+  case OP_REMOVE:
+  case OP_REMOVE_Z: {
+    int pos = fuzz_pos(in, m->length);
+    CListElementType got;
+    if (fuzz_op == OP_REMOVE)
+      FUZZ_TIME(got = CL_remove(list, pos));
+    else
+      FUZZ_TIME(got = CL_remove_z(list, pos));
+    fuzz_check( got == (model_nth_pos(m, pos, &at) ? model_remove(m, at)
+                        : INVALID_RETURN) );
+    break;
+  }
+
+  case OP_COPY: {
+    CList copy;
+    int threads = fuzz_byte(in) % 4;
+    if (threads == 0)
+      FUZZ_TIME(copy = CL_copy(list));
+    else
+      FUZZ_TIME(copy = CL_copy_parallel(list, threads));
+    fuzz_check_list(copy, m);
+    if (fuzz_byte(in) % 2)
+      FUZZ_TIME(CL_free(copy));
+    else
+      FUZZ_TIME(CL_free_deferred(copy));
+    break;
+  }
+
+  case OP_JOIN:
+    FUZZ_TIME(CL_join(list, other));
+    model_join(m, mo);
+    break;
+
+  case OP_REVERSE:
+    FUZZ_TIME(CL_reverse(list));
+    for (size_t i = 0; i < m->length / 2; i++) {
+      const char *e = m->items[i];
+      m->items[i] = m->items[m->length - 1 - i];
+      m->items[m->length - 1 - i] = e;
+    }
+    break;
+
+  case OP_FOREACH:
+  case OP_FOREACH_Z:
+  case OP_FOREACH_BATCH:
+  case OP_FOR_EACH: {
+    struct fuzz_walk walk = {m, 0, 0, true};
+    if (fuzz_op == OP_FOREACH)
+      FUZZ_TIME(CL_foreach(list, fuzz_visit, &walk));
+    else if (fuzz_op == OP_FOREACH_Z)
+      FUZZ_TIME(CL_foreach_z(list, fuzz_visit_z, &walk));
+    else if (fuzz_op == OP_FOREACH_BATCH)
+      FUZZ_TIME(CL_foreach_batch(list, fuzz_visit_batch, &walk));
+    else {
+      CListElementType elem;
+      FUZZ_TIME(CL_FOR_EACH(list, elem) fuzz_visit(walk.seen, elem, &walk));
+    }
+    fuzz_check( walk.ok && walk.seen == m->length );
+    break;
+  }
+
+  case OP_SORT: {
+    CL_compare_fn cmp = fuzz_cmp(in);
+    if (cmp == NULL)
+      FUZZ_TIME(CL_sort(list));
+    else
+      FUZZ_TIME(CL_sort_cmp(list, cmp));
+    model_sort(m);
+    break;
+  }
+
+  case OP_SORT_RADIX:
+    FUZZ_TIME(CL_sort_radix(list));
+    model_sort(m);
+    break;
+
+  case OP_INSERT_SORTED: {
+    // Defined on unsorted lists too: the element goes before the first
+    // element that sorts after it
+    CL_compare_fn cmp = fuzz_cmp(in);
+    const char *e = fuzz_element(in);
+    int got;
+    if (cmp == NULL)
+      FUZZ_TIME(got = CL_insert_sorted(list, e));
+    else
+      FUZZ_TIME(got = CL_insert_sorted_cmp(list, e, cmp));
+    for (at = 0; at < m->length && strcmp(m->items[at], e) <= 0; at++)
+      ;
+    fuzz_check( got == (int) at );
+    model_insert(m, at, e);
+    break;
+  }
+
+  case OP_FIND_SORTED: {
+    fuzz_make_sorted(list, m);
+    CL_compare_fn cmp = fuzz_cmp(in);
+    const char *e = fuzz_element(in);
+    int got;
+    if (cmp == NULL)
+      FUZZ_TIME(got = CL_find_sorted(list, e));
+    else
+      FUZZ_TIME(got = CL_find_sorted_cmp(list, e, cmp));
+    for (at = 0; at < m->length && strcmp(m->items[at], e) < 0; at++)
+      ;
+    if (at == m->length || strcmp(m->items[at], e) != 0)
+      fuzz_check( got == -1 );
+    else
+      fuzz_check( got == (int) at );
+    break;
+  }
+
+  case OP_MERGE_SORTED: {
+    fuzz_make_sorted(list, m);
+    fuzz_make_sorted(other, mo);
+    CL_compare_fn cmp = fuzz_cmp(in);
+    if (cmp == NULL)
+      FUZZ_TIME(CL_merge_sorted(list, other));
+    else
+      FUZZ_TIME(CL_merge_sorted_cmp(list, other, cmp));
+    // Equal elements of list come before those of other
+    size_t length = m->length;
+    model_join(m, mo);
+    for (size_t i = length; i < m->length; i++) {
+      const char *e = m->items[i];
+      size_t j = i;
+      for (; j > 0 && strcmp(m->items[j - 1], e) > 0; j--)
+        m->items[j] = m->items[j - 1];
+      m->items[j] = e;
+    }
+    break;
+  }
+
+  case OP_INTERSECT_SORTED:
+  case OP_DIFFERENCE_SORTED: {
+    fuzz_make_sorted(list, m);
+    fuzz_make_sorted(other, mo);
+    CL_compare_fn cmp = fuzz_cmp(in);
+    bool intersect = (fuzz_op == OP_INTERSECT_SORTED);
+    if (intersect && cmp == NULL)
+      FUZZ_TIME(CL_intersect_sorted(list, other));
+    else if (intersect)
+      FUZZ_TIME(CL_intersect_sorted_cmp(list, other, cmp));
+    else if (cmp == NULL)
+      FUZZ_TIME(CL_difference_sorted(list, other));
+    else
+      FUZZ_TIME(CL_difference_sorted_cmp(list, other, cmp));
+    model_filter_sorted(m, mo, intersect);
+    break;
+  }
+
+  case OP_MERGE_SORTED_K: {
+    // Merge both lists and a third, short one into a new list, which
+    // replaces lists[0]
+    CList third = CL_new();
+    struct model m3 = {NULL, 0, 0};
+    int n = fuzz_below(in, 8);
+    for (int i = 0; i < n; i++) {
+      const char *e = fuzz_element(in);
+      CL_push(third, e);
+      model_insert(&m3, 0, e);
+    }
+    CL_sort(third);
+    model_sort(&m3);
+    fuzz_make_sorted(lists[0], &models[0]);
+    fuzz_make_sorted(lists[1], &models[1]);
+
+    CList inputs[3] = {lists[0], lists[1], third};
+    CL_compare_fn cmp = fuzz_cmp(in);
+    CList merged;
+    if (cmp == NULL)
+      FUZZ_TIME(merged = CL_merge_sorted_k(inputs, 3));
+    else
+      FUZZ_TIME(merged = CL_merge_sorted_k_cmp(inputs, 3, cmp));
+    for (int i = 0; i < 3; i++)
+      fuzz_check( CL_length(inputs[i]) == 0 );
+    CL_free(lists[0]);
+    CL_free(third);
+    lists[0] = merged;
+
+    // Equal elements keep the order of the lists they came from
+    model_join(&models[0], &models[1]);
+    model_join(&models[0], &m3);
+    model_sort(&models[0]);
+    free(m3.items);
+    break;
+  }
+
+  case OP_UNIQUE: {
+    // Defined on unsorted lists too: it removes adjacent duplicates
+    CL_compare_fn cmp = fuzz_cmp(in);
+    int got;
+    if (cmp == NULL)
+      FUZZ_TIME(got = CL_unique(list));
+    else
+      FUZZ_TIME(got = CL_unique_cmp(list, cmp));
+    size_t length = m->length;
+    for (size_t keep = 0; keep + 1 < m->length; ) {
+      if (strcmp(m->items[keep], m->items[keep + 1]) == 0)
+        model_remove(m, keep + 1);
+      else
+        keep++;
+    }
+    fuzz_check( got == (int) (length - m->length) );
+    break;
+  }
+
+  case OP_DEDUP: {
+    int got;
+    FUZZ_TIME(got = CL_dedup(list));
+    size_t length = m->length;
+    for (size_t i = 1; i < m->length; ) {
+      size_t j = 0;
+      while (j < i && strcmp(m->items[j], m->items[i]) != 0)
+        j++;
+      if (j < i)
+        model_remove(m, i);
+      else
+        i++;
+    }
+    fuzz_check( got == (int) (length - m->length) );
+    break;
+  }
+
+  case OP_REMOVE_IF:
+  case OP_EXTRACT_IF: {
+    // The extracted elements replace the other list
+    char limit = (char) fuzz_byte(in);
+    int got = 0;
+    CList extracted = NULL;
+    if (fuzz_op == OP_REMOVE_IF)
+      FUZZ_TIME(got = CL_remove_if(list, fuzz_select, &limit));
+    else
+      FUZZ_TIME(extracted = CL_extract_if(list, fuzz_select, &limit));
+    size_t length = m->length;
+    if (extracted != NULL) {
+      CL_free(other);
+      lists[1 - t] = extracted;
+      mo->length = 0;
+    }
+    for (size_t i = 0; i < m->length; ) {
+      if (fuzz_select(m->items[i], &limit)) {
+        CListElementType removed = model_remove(m, i);
+        if (extracted != NULL)
+          model_insert(mo, mo->length, removed);
+      } else {
+        i++;
+      }
+    }
+    if (extracted == NULL)
+      fuzz_check( got == (int) (length - m->length) );
+    break;
+  }
+
+  case OP_SPLIT: {
+    // The tail replaces the other list
+    int pos = fuzz_pos(in, m->length);
+    CList tail;
+    FUZZ_TIME(tail = CL_split(list, pos));
+    fuzz_check( (tail != NULL) == model_insert_pos(m, pos, &at) );
+    if (tail == NULL)
+      break;
+    CL_free(other);
+    lists[1 - t] = tail;
+    mo->length = 0;
+    while (m->length > at)
+      model_insert(mo, 0, model_remove(m, m->length - 1));
+    break;
+  }
+
+  case OP_SPLICE: {
+    int pos = fuzz_pos(in, m->length);
+    int from = fuzz_pos(in, mo->length);
+    int count = fuzz_below(in, (int) mo->length + 3) - 1;
+    bool ok;
+    FUZZ_TIME(ok = CL_splice(list, pos, other, from, count));
+    // Same rules as CL_insert for pos, and CL_nth for from, except
+    // that an empty range may start at the end of other
+    ptrdiff_t src_at = (from < 0) ? from + (ptrdiff_t) mo->length : from;
+    bool valid = model_insert_pos(m, pos, &at) && count >= 0 && src_at >= 0
+      && count <= (ptrdiff_t) mo->length - src_at;
+    fuzz_check( ok == valid );
+    if (ok)
+      for (int i = 0; i < count; i++)
+        model_insert(m, at + i, model_remove(mo, src_at));
+    break;
+  }
+
+  case OP_SLICE: {
+    int from = fuzz_pos(in, m->length);
+    int count = fuzz_below(in, (int) m->length + 3) - 1;
+    CListSlice slice;
+    FUZZ_TIME(slice = CL_slice(list, from, count));
+    bool valid = count > 0 && model_nth_pos(m, from, &at)
+      && (size_t) count <= m->length - at;
+    fuzz_check( CL_slice_length(slice) == (valid ? count : 0) );
+    if (!valid)
+      break;
+
+    struct model view = {m->items + at, (size_t) count, 0};
+    int pos = fuzz_pos(in, count);
+    size_t view_at;
+    fuzz_check( CL_slice_nth(slice, pos) ==
+                (model_nth_pos(&view, pos, &view_at) ? view.items[view_at]
+                 : INVALID_RETURN) );
+    struct fuzz_walk walk = {m, at, 0, true};
+    CL_slice_foreach(slice, fuzz_visit, &walk);
+    fuzz_check( walk.ok && walk.seen == (size_t) count );
+    CList copy = CL_slice_copy(slice);
+    fuzz_check_list(copy, &view);
+    CL_free(copy);
+    break;
+  }
+
+  case OP_COMPACT:
+    FUZZ_TIME(CL_compact(list));
+    fuzz_check( CL_fragmentation(list) == 0.0 );
+    break;
+
+  case OP_AUTO_COMPACT: {
+    static const double thresholds[] = {0.0, 0.3, 0.9};
+    FUZZ_TIME(CL_set_auto_compact(list, thresholds[fuzz_byte(in) % 3]));
+    double fragmentation = CL_fragmentation(list);
+    fuzz_check( fragmentation >= 0.0 && fragmentation <= 1.0 );
+    break;
+  }
+
+  case OP_SET_KEY:
+    // Keys for strcasecmp are ignored by the strcmp-ordered operations
+    switch (fuzz_byte(in) % 4) {
+    case 0: FUZZ_TIME(CL_set_key(list, NULL, NULL)); break;
+    case 1: FUZZ_TIME(CL_set_key(list, CL_strcmp, CL_key_prefix)); break;
+    case 2: FUZZ_TIME(CL_set_key(list, strcmp, CL_key_prefix)); break;
+    default:
+      FUZZ_TIME(CL_set_key(list, strcasecmp, CL_key_prefix_nocase));
+    }
+    break;
+
+  case OP_CLEAR:
+    FUZZ_TIME(CL_free(list); lists[t] = CL_new());
+    m->length = 0;
+    break;
+  }
+
+  // Keep the lists short
+  for (int i = 0; i < 2; i++) {
+    if (models[i].length > FUZZ_MAX_LENGTH) {
+      CL_free(lists[i]);
+      lists[i] = CL_new();
+      models[i].length = 0;
+    }
+  }
+
+  fuzz_check_list(lists[0], &models[0]);
+  fuzz_check_list(lists[1], &models[1]);
+}
+
+
+/*
+ * Run operations on two lists, until max_ops have run (if max_ops is
+ * not negative) or the input is used up
+ *
+ * Returns: None
+ */
+static void fuzz_run(struct fuzz_input *in, long max_ops)
+{
+  CList lists[2] = {CL_new(), CL_new()};
+  struct model models[2] = {{NULL, 0, 0}, {NULL, 0, 0}};
+
+  for (long i = 0; (max_ops < 0 || i < max_ops) && !fuzz_done(in); i++) {
+    fuzz_num_ops++;
+    fuzz_step(in, lists, models);
+  }
+
+  for (int i = 0; i < 2; i++) {
+    CL_free(lists[i]);
+    free(models[i].items);
+  }
+  CL_free_wait();  // For the copies freed in the background
+}
+
+
+// Make the elements, at addresses of their own
+static void fuzz_init()
+{
+  for (int i = 0; i < FUZZ_NUM_ELEMENTS; i++) {
+    fuzz_elements[i] = strdup(fuzz_strings[i]);
+    if (fuzz_elements[i] == NULL) abort();
+  }
+}
+
+
+#ifdef CL_FUZZ_LIBFUZZER
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+  static bool ready = false;
+  if (!ready) {
+    fuzz_init();
+    ready = true;
+  }
+
+  struct fuzz_input in = {data, size, 0, 0};
+  fuzz_run(&in, -1);
+  return 0;
+}
+
+#else
+
+int main(int argc, char *argv[])
+{
+  long num_ops = (argc > 1) ? atol(argv[1]) : 200000;
+  unsigned long seed = (argc > 2) ? strtoul(argv[2], NULL, 0)
+    : (unsigned long) time(NULL);
+
+  printf("Running %ld operations, seed %lu\n", num_ops, seed);
+  fflush(stdout);
+
+  fuzz_init();
+  struct fuzz_input in = {NULL, 0, 0, seed ? seed : 1};
+  fuzz_run(&in, num_ops);
+
+  printf("  %-24s %10s %12s %10s\n", "operation", "calls", "total ms",
+         "ns/call");
+  for (int op = 0; op < NUM_OPS; op++)
+    printf("  %-24s %10lu %12.3f %10.1f\n", fuzz_op_names[op], fuzz_counts[op],
+           fuzz_seconds[op] * 1e3,
+           fuzz_counts[op] ? fuzz_seconds[op] * 1e9 / fuzz_counts[op] : 0.0);
+  printf("Passed %lu operations\n", fuzz_num_ops);
+
+  for (int i = 0; i < FUZZ_NUM_ELEMENTS; i++)
+    free(fuzz_elements[i]);
+  return 0;
+}
+
+#endif
@@ -0,0 +1,226 @@
+/*
+ * clist_pq.c
+ *
+ * Priority queue of CList elements, kept as a pairing heap
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include "clist_pq.h"
+
+struct _cl_pq_node {
+  CListElementType element;
+  struct _cl_pq_node *child;    // first child, which is not smaller
+  struct _cl_pq_node *sibling;  // next child of the same parent
+};
+
+struct _cl_pq {
+  struct _cl_pq_node *root;     // smallest element, or NULL if empty
+  size_t length;
+  CL_compare_fn cmp;
+};
+
+
+
+/*
+ * Link two heaps into one: the root that is larger becomes the first
+ * child of the other
+ *
+ * Parameters:
+ *   a, b     Roots of the heaps, which have no siblings
+ *   cmp      The comparator
+ *
+ * Returns: The root of the linked heap
+ */
+static struct _cl_pq_node *
+_PQ_link(struct _cl_pq_node *a, struct _cl_pq_node *b, CL_compare_fn cmp)
+{
+  if (cmp(b->element, a->element) < 0) {
+    struct _cl_pq_node *tmp = a;
+    a = b;
+    b = tmp;
+  }
+  b->sibling = a->child;
+  a->child = b;
+  return a;
+}
+
+
+
+/*
+ * Combine the children of a removed root into one heap, in two
+ * passes: link the children in pairs from left to right, then link
+ * the pairs into one heap from right to left. The pairs are kept on
+ * a chain in reverse order, so neither pass needs recursion.
+ *
+ * Parameters:
+ *   first    The first child, or NULL
+ *   cmp      The comparator
+ *
+ * Returns: The root of the combined heap, or NULL if first is NULL
+ */
+static struct _cl_pq_node *
+_PQ_merge_pairs(struct _cl_pq_node *first, CL_compare_fn cmp)
+{
+  struct _cl_pq_node *pairs = NULL;
+
+  while (first != NULL) {
+    struct _cl_pq_node *a = first;
+    struct _cl_pq_node *b = a->sibling;
+    if (b == NULL) {
+      a->sibling = pairs;
+      pairs = a;
+      break;
+    }
+    first = b->sibling;
+    a->sibling = NULL;
+    b->sibling = NULL;
+    struct _cl_pq_node *pair = _PQ_link(a, b, cmp);
+    pair->sibling = pairs;
+    pairs = pair;
+  }
+
+  if (pairs == NULL)
+    return NULL;
+
+  struct _cl_pq_node *root = pairs;
+  pairs = pairs->sibling;
+  root->sibling = NULL;
+  while (pairs != NULL) {
+    struct _cl_pq_node *next = pairs->sibling;
+    pairs->sibling = NULL;
+    root = _PQ_link(pairs, root, cmp);
+    pairs = next;
+  }
+  return root;
+}
+
+
+
+// Documented in .h file
+CListPQ PQ_new()
+{
+  return PQ_new_cmp(CL_strcmp);
+}
+
+
+
+// Documented in .h file
+CListPQ PQ_new_cmp(CL_compare_fn cmp)
+{
+  assert(cmp);
+
+  CListPQ pq = (CListPQ) malloc(sizeof(struct _cl_pq));
+  assert(pq);
+
+  pq->root = NULL;
+  pq->length = 0;
+  pq->cmp = cmp;
+
+  return pq;
+}
+
+
+
+// Documented in .h file
+void PQ_free(CListPQ pq)
+{
+  if (pq == NULL) return;
+
+  // Walk the tree as one chain: before a node is freed, its children
+  // are spliced in between it and its next sibling
+  struct _cl_pq_node *node = pq->root;
+  while (node != NULL) {
+    if (node->child != NULL) {
+      struct _cl_pq_node *last = node->child;
+      while (last->sibling != NULL)
+        last = last->sibling;
+      last->sibling = node->sibling;
+      node->sibling = node->child;
+    }
+    struct _cl_pq_node *next = node->sibling;
+    free(node);
+    node = next;
+  }
+
+  free(pq);
+}
+
+
+
+// Documented in .h file
+size_t PQ_length(CListPQ pq)
+{
+  assert(pq);
+  return pq->length;
+}
+
+
+
+// Documented in .h file
+void PQ_push(CListPQ pq, CListElementType element)
+{
+  assert(pq);
+
+  struct _cl_pq_node *node =
+    (struct _cl_pq_node *) malloc(sizeof(struct _cl_pq_node));
+  assert(node);
+
+  node->element = element;
+  node->child = NULL;
+  node->sibling = NULL;
+
+  pq->root = (pq->root == NULL) ? node : _PQ_link(pq->root, node, pq->cmp);
+  pq->length++;
+}
+
+
+
+// Documented in .h file
+CListElementType PQ_peek_min(CListPQ pq)
+{
+  assert(pq);
+
+  if (pq->root == NULL)
+    return INVALID_RETURN;
+  return pq->root->element;
+}
+
+
+
+// Documented in .h file
+CListElementType PQ_pop_min(CListPQ pq)
+{
+  assert(pq);
+
+  struct _cl_pq_node *root = pq->root;
+  if (root == NULL)
+    return INVALID_RETURN;
+
+  CListElementType ret = root->element;
+  pq->root = _PQ_merge_pairs(root->child, pq->cmp);
+  pq->length--;
+  free(root);
+
+  return ret;
+}
+
+
+
+// Documented in .h file
+void PQ_meld(CListPQ pq1, CListPQ pq2)
+{
+  assert(pq1);
+  assert(pq2);
+  assert(pq1 != pq2);
+  assert(pq1->cmp == pq2->cmp);
+
+  if (pq2->root == NULL) return;  // Nothing to meld
+
+  pq1->root = (pq1->root == NULL) ? pq2->root
+    : _PQ_link(pq1->root, pq2->root, pq1->cmp);
+  pq1->length += pq2->length;
+  pq2->root = NULL;
+  pq2->length = 0;
+}
@@ -0,0 +1,123 @@
+/*
+ * clist_pq.h
+ *
+ * Priority queue of CList elements, kept as a pairing heap: a tree of
+ * list-style nodes in which each node links to its first child and
+ * its next sibling. Pushing and melding two queues take constant
+ * time, and popping the smallest element takes amortized O(log n)
+ * time, where keeping a CList sorted costs O(n) per insertion.
+ *
+ * Elements are ordered by a CL_compare_fn, as for the sorted CList
+ * operations. Elements that compare equal come out in no particular
+ * order.
+ */
+
+#ifndef _CLIST_PQ_H_
+#define _CLIST_PQ_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "clist.h"
+
+// struct _cl_pq is defined in .c file
+typedef struct _cl_pq *CListPQ;
+
+
+/*
+ * Create a new, empty priority queue
+ *
+ * Ordering is done following the rules for the strcmp function.
+ *
+ * Parameters: None
+ *
+ * Returns: The new queue
+ */
+CListPQ PQ_new();
+
+
+/*
+ * As PQ_new, but elements are ordered by cmp.
+ *
+ * Parameters:
+ *   cmp      The comparator
+ *
+ * Returns: The new queue
+ */
+CListPQ PQ_new_cmp(CL_compare_fn cmp);
+
+
+/*
+ * Destroy a priority queue, calling free() on all malloc'd memory.
+ *
+ * Parameters:
+ *   pq     The queue; if NULL, no action will occur
+ *
+ * Returns: None
+ */
+void PQ_free(CListPQ pq);
+
+
+/*
+ * Compute the number of elements in a priority queue
+ *
+ * Parameters:
+ *   pq     The queue
+ *
+ * Returns: The number of elements
+ */
+size_t PQ_length(CListPQ pq);
+
+
+/*
+ * Add an element to a priority queue. Runs in constant time.
+ *
+ * Parameters:
+ *   pq       The queue
+ *   element  The element to add
+ *
+ * Returns: None
+ */
+void PQ_push(CListPQ pq, CListElementType element);
+
+
+/*
+ * Return the smallest element of a priority queue, without removing
+ * it. If the queue is empty, return INVALID_RETURN.
+ *
+ * Parameters:
+ *   pq     The queue
+ *
+ * Returns: The smallest element, or INVALID_RETURN if pq is empty
+ */
+CListElementType PQ_peek_min(CListPQ pq);
+
+
+/*
+ * Remove and return the smallest element of a priority queue. If the
+ * queue is empty, return INVALID_RETURN. Runs in amortized O(log n)
+ * time.
+ *
+ * Parameters:
+ *   pq     The queue
+ *
+ * Returns: The smallest element, or INVALID_RETURN if pq is empty
+ */
+CListElementType PQ_pop_min(CListPQ pq);
+
+
+/*
+ * Meld two priority queues ordered by the same comparator. The
+ * elements of pq2 are moved to pq1 in constant time; afterwards pq2
+ * will still exist, but it will be empty, as for CL_join.
+ *
+ * Parameters:
+ *   pq1      The queue receiving the elements
+ *   pq2      The queue giving up its elements
+ *
+ * Returns: None
+ */
+void PQ_meld(CListPQ pq1, CListPQ pq2);
+
+
+#endif /* _CLIST_PQ_H_ */
@@ -0,0 +1,277 @@
+/*
+ * clist_queue.c
+ *
+ * Producer-consumer queue, built on a CList guarded by a mutex
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+
+#include "clist_queue.h"
+
+struct _cl_queue {
+  CList list;                   // the queued elements
+  pthread_mutex_t lock;         // guards every field below, and list
+  pthread_cond_t arrived;       // signalled when elements are added
+  int waiters;                  // threads blocked in CLQ_pop_wait
+  int fd;                       // eventfd, readable if signalled
+  bool signalled;               // fd has been written and not drained
+  bool closed;
+};
+
+
+
+/*
+ * Make the queue's file descriptor readable, if it is not already.
+ * The queue's lock must be held.
+ *
+ * Returns: None
+ */
+static void
+_CLQ_signal_fd(CListQueue queue)
+{
+  if (queue->signalled) return;
+
+  uint64_t one = 1;
+  ssize_t written = write(queue->fd, &one, sizeof(one));
+  assert(written == sizeof(one));
+  (void) written;
+  queue->signalled = true;
+}
+
+
+
+/*
+ * Reset the queue's file descriptor once the queue has been emptied,
+ * unless the queue is closed, which keeps it readable. The queue's
+ * lock must be held.
+ *
+ * Returns: None
+ */
+static void
+_CLQ_drain_fd(CListQueue queue)
+{
+  if (!queue->signalled || queue->closed || CL_length(queue->list) > 0)
+    return;
+
+  uint64_t count;
+  ssize_t got = read(queue->fd, &count, sizeof(count));
+  assert(got == sizeof(count));
+  (void) got;
+  queue->signalled = false;
+}
+
+
+
+/*
+ * Wake the consumers after elements have been added to the queue.
+ * The queue's lock must be held.
+ *
+ * Parameters:
+ *   queue    The queue, not closed
+ *   count    The number of elements added; greater than 0
+ *
+ * Returns: None
+ */
+static void
+_CLQ_wake(CListQueue queue, int count)
+{
+  _CLQ_signal_fd(queue);
+
+  if (queue->waiters == 0) return;
+  if (count == 1)
+    pthread_cond_signal(&queue->arrived);
+  else
+    pthread_cond_broadcast(&queue->arrived);
+}
+
+
+
+// Documented in .h file
+CListQueue CLQ_new()
+{
+  CListQueue queue = (CListQueue) malloc(sizeof(struct _cl_queue));
+  assert(queue);
+
+  queue->list = CL_new();
+  queue->waiters = 0;
+  queue->signalled = false;
+  queue->closed = false;
+
+  queue->fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  assert(queue->fd >= 0);
+
+  // Timeouts are measured on the monotonic clock, so that they are
+  // not affected by changes to the time of day
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&queue->arrived, &attr);
+  pthread_condattr_destroy(&attr);
+  pthread_mutex_init(&queue->lock, NULL);
+
+  return queue;
+}
+
+
+
+// Documented in .h file
+void CLQ_free(CListQueue queue)
+{
+  if (queue == NULL) return;
+
+  assert(queue->waiters == 0);
+  pthread_cond_destroy(&queue->arrived);
+  pthread_mutex_destroy(&queue->lock);
+  close(queue->fd);
+  CL_free(queue->list);
+  free(queue);
+}
+
+
+
+// Documented in .h file
+int CLQ_length(CListQueue queue)
+{
+  assert(queue);
+
+  pthread_mutex_lock(&queue->lock);
+  int length = CL_length(queue->list);
+  pthread_mutex_unlock(&queue->lock);
+
+  return length;
+}
+
+
+
+// Documented in .h file
+bool CLQ_append(CListQueue queue, CListElementType element)
+{
+  assert(queue);
+
+  pthread_mutex_lock(&queue->lock);
+  bool ok = !queue->closed;
+  if (ok) {
+    CL_append(queue->list, element);  // Constant time, with the tail known
+    _CLQ_wake(queue, 1);
+  }
+  pthread_mutex_unlock(&queue->lock);
+
+  return ok;
+}
+
+
+
+// Documented in .h file
+bool CLQ_append_all(CListQueue queue, CList list)
+{
+  assert(queue);
+  assert(list);
+
+  pthread_mutex_lock(&queue->lock);
+  bool ok = !queue->closed;
+  int count = CL_length(list);
+  if (ok && count > 0) {
+    CL_join(queue->list, list);  // Moves a whole batch in constant time
+    _CLQ_wake(queue, count);
+  }
+  pthread_mutex_unlock(&queue->lock);
+
+  return ok;
+}
+
+
+
+// Documented in .h file
+CListElementType CLQ_pop(CListQueue queue)
+{
+  assert(queue);
+
+  pthread_mutex_lock(&queue->lock);
+  CListElementType ret = CL_pop(queue->list);
+  _CLQ_drain_fd(queue);
+  pthread_mutex_unlock(&queue->lock);
+
+  return ret;
+}
+
+
+
+// Documented in .h file
+CListElementType CLQ_pop_wait(CListQueue queue, int timeout_ms)
+{
+  assert(queue);
+
+  struct timespec deadline;
+  if (timeout_ms >= 0) {
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long) (timeout_ms % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000;
+    }
+  }
+
+  pthread_mutex_lock(&queue->lock);
+  while (CL_length(queue->list) == 0 && !queue->closed) {
+    int err = 0;
+    queue->waiters++;
+    if (timeout_ms < 0)
+      pthread_cond_wait(&queue->arrived, &queue->lock);
+    else
+      err = pthread_cond_timedwait(&queue->arrived, &queue->lock, &deadline);
+    queue->waiters--;
+    if (err == ETIMEDOUT) break;
+  }
+  CListElementType ret = CL_pop(queue->list);
+  _CLQ_drain_fd(queue);
+  pthread_mutex_unlock(&queue->lock);
+
+  return ret;
+}
+
+
+
+// Documented in .h file
+void CLQ_close(CListQueue queue)
+{
+  assert(queue);
+
+  pthread_mutex_lock(&queue->lock);
+  queue->closed = true;
+  _CLQ_signal_fd(queue);
+  pthread_cond_broadcast(&queue->arrived);
+  pthread_mutex_unlock(&queue->lock);
+}
+
+
+
+// Documented in .h file
+bool CLQ_is_closed(CListQueue queue)
+{
+  assert(queue);
+
+  pthread_mutex_lock(&queue->lock);
+  bool closed = queue->closed;
+  pthread_mutex_unlock(&queue->lock);
+
+  return closed;
+}
+
+
+
+// Documented in .h file
+int CLQ_fd(CListQueue queue)
+{
+  assert(queue);
+  return queue->fd;
+}
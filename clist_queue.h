@@ -0,0 +1,144 @@
+/*
+ * clist_queue.h
+ *
+ * Producer-consumer queue: a CList shared between threads, from which
+ * consumers take elements in FIFO order. A consumer can block until
+ * an element arrives (CLQ_pop_wait), or, in an event loop, wait for
+ * the queue's file descriptor to become readable with poll, select or
+ * epoll (CLQ_fd) and then take elements with CLQ_pop.
+ *
+ * The file descriptor is an eventfd, so the queue is Linux only. It
+ * is written once when the queue goes from empty to non-empty and
+ * drained when it is emptied again, so a burst of appends costs one
+ * wake-up however many elements it adds.
+ *
+ * All functions may be called from any thread, except CLQ_free.
+ */
+
+#ifndef _CLIST_QUEUE_H_
+#define _CLIST_QUEUE_H_
+
+#include <stdbool.h>
+
+#include "clist.h"
+
+// struct _cl_queue is defined in .c file
+typedef struct _cl_queue *CListQueue;
+
+
+/*
+ * Create a new, empty queue
+ *
+ * Parameters: None
+ *
+ * Returns: The new queue
+ */
+CListQueue CLQ_new();
+
+
+/*
+ * Destroy a queue, calling free() on all malloc'd memory and closing
+ * its file descriptor. No thread may be using the queue.
+ *
+ * Parameters:
+ *   queue    The queue; if NULL, no action will occur
+ *
+ * Returns: None
+ */
+void CLQ_free(CListQueue queue);
+
+
+// As CL_length
+int CLQ_length(CListQueue queue);
+
+
+/*
+ * Add an element to the end of the queue, waking one thread blocked
+ * in CLQ_pop_wait, and making the queue's file descriptor readable if
+ * the queue was empty.
+ *
+ * Parameters:
+ *   queue    The queue
+ *   element  The element to add
+ *
+ * Returns: false if the queue has been closed, in which case the
+ *   element is not added; true otherwise
+ */
+bool CLQ_append(CListQueue queue, CListElementType element);
+
+
+/*
+ * Move every element of list to the end of the queue, in order, with
+ * a single wake-up: blocked threads are woken once, and the file
+ * descriptor is written at most once. Takes constant time, as
+ * CL_join. list is left empty.
+ *
+ * Parameters:
+ *   queue    The queue
+ *   list     The elements to add
+ *
+ * Returns: false if the queue has been closed, in which case list is
+ *   left unchanged; true otherwise
+ */
+bool CLQ_append_all(CListQueue queue, CList list);
+
+
+/*
+ * Remove and return the first element of the queue, without waiting
+ *
+ * Parameters:
+ *   queue    The queue
+ *
+ * Returns: The element, or INVALID_RETURN if the queue is empty
+ */
+CListElementType CLQ_pop(CListQueue queue);
+
+
+/*
+ * Remove and return the first element of the queue, waiting for one
+ * to be added if the queue is empty.
+ *
+ * Parameters:
+ *   queue        The queue
+ *   timeout_ms   The longest time to wait, in milliseconds; if < 0,
+ *                wait until an element arrives or the queue is closed
+ *
+ * Returns: The element, or INVALID_RETURN if the timeout expired, or
+ *   the queue is closed and empty
+ */
+CListElementType CLQ_pop_wait(CListQueue queue, int timeout_ms);
+
+
+/*
+ * Close the queue: later appends fail, and once the queue is empty,
+ * CLQ_pop_wait returns INVALID_RETURN at once. Threads blocked in
+ * CLQ_pop_wait are woken, and the file descriptor is made readable
+ * so that event loops notice.
+ *
+ * Parameters:
+ *   queue    The queue
+ *
+ * Returns: None
+ */
+void CLQ_close(CListQueue queue);
+
+
+// Returns true if CLQ_close has been called on the queue
+bool CLQ_is_closed(CListQueue queue);
+
+
+/*
+ * Return the queue's file descriptor, for poll, select or epoll. It
+ * is readable while the queue holds elements or has been closed, and
+ * is reset by the pop that empties the queue, so it can be used with
+ * level-triggered polling. Do not read from, write to or close it.
+ *
+ * Parameters:
+ *   queue    The queue
+ *
+ * Returns: The file descriptor
+ */
+int CLQ_fd(CListQueue queue);
+
+
+#endif /* _CLIST_QUEUE_H_ */
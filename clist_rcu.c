@@ -0,0 +1,483 @@
+/*
+ * clist_rcu.c
+ *
+ * RCU list: a linked list whose readers take no lock, with removed
+ * nodes freed by epoch-based reclamation
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "clist_rcu.h"
+
+// Retired nodes that make a writer try to free some
+#define CLRCU_RECLAIM_BATCH 64
+
+struct _clrcu_node {
+  CListElementType element;
+  _Atomic(struct _clrcu_node *) next;
+};
+
+// A node removed from the list, and the epoch it was removed in. These
+// are kept apart from the nodes, which stay as small as CList's.
+struct _clrcu_retired {
+  struct _clrcu_node *node;
+  uint64_t epoch;
+};
+
+// A reader's slot: 0 if free, else the epoch its reader started in.
+// Each is on a cache line of its own, so that readers on different
+// slots do not slow each other down.
+struct _clrcu_slot {
+  atomic_uint_fast64_t epoch;
+  char pad[64 - sizeof(atomic_uint_fast64_t)];
+};
+
+struct _cl_rcu {
+  _Atomic(struct _clrcu_node *) head;
+  atomic_int length;
+  atomic_uint_fast64_t epoch;         // current epoch; starts at 1
+  pthread_mutex_t lock;               // held by writers; guards the
+                                      // fields below, and the links
+  _Atomic(struct _clrcu_node *) *tail;  // the link that is NULL
+  struct _clrcu_retired *retired;     // oldest first
+  int max_retired;                    // allocated size of retired
+  atomic_int pending;                 // entries in retired
+  int reclaim_at;                     // pending that makes writers reclaim
+  struct _clrcu_slot readers[CLRCU_MAX_READERS];
+};
+
+// Slot the calling thread last read from, where it looks first
+static _Thread_local int _CLRCU_slot_hint = 0;
+
+
+
+/*
+ * Start a read: claim a reader slot and record the current epoch in
+ * it. Nodes retired from this epoch on are not freed until the read
+ * ends.
+ *
+ * Parameters:
+ *   list     The list
+ *
+ * Returns: The slot claimed, to pass to _CLRCU_read_end
+ */
+static int
+_CLRCU_read_begin(CListRCU list)
+{
+  int slot = _CLRCU_slot_hint;
+
+  for (;;) {
+    for (int i = 0; i < CLRCU_MAX_READERS; i++) {
+      uint_fast64_t free_slot = 0;
+      uint_fast64_t epoch = atomic_load(&list->epoch);
+      if (atomic_compare_exchange_strong(&list->readers[slot].epoch,
+                                         &free_slot, epoch)) {
+        // Either a writer scanning the slots sees this one, or this
+        // reader sees the links as the writer left them
+        atomic_thread_fence(memory_order_seq_cst);
+        _CLRCU_slot_hint = slot;
+        return slot;
+      }
+      slot = (slot + 1) % CLRCU_MAX_READERS;
+    }
+    sched_yield();  // Every slot is in use
+  }
+}
+
+
+
+/*
+ * End a read started by _CLRCU_read_begin
+ *
+ * Parameters:
+ *   list     The list
+ *   slot     The slot the read claimed
+ *
+ * Returns: None
+ */
+static void
+_CLRCU_read_end(CListRCU list, int slot)
+{
+  atomic_store_explicit(&list->readers[slot].epoch, 0, memory_order_release);
+}
+
+
+
+/*
+ * Free the retired nodes that were retired before the epoch every
+ * current reader started in. The writer lock must be held.
+ *
+ * Returns: None
+ */
+static void
+_CLRCU_reclaim(CListRCU list)
+{
+  // Pairs with the fence in _CLRCU_read_begin
+  atomic_thread_fence(memory_order_seq_cst);
+
+  uint64_t oldest = UINT64_MAX;
+  for (int i = 0; i < CLRCU_MAX_READERS; i++) {
+    uint64_t epoch = atomic_load_explicit(&list->readers[i].epoch,
+                                          memory_order_acquire);
+    if (epoch != 0 && epoch < oldest)
+      oldest = epoch;
+  }
+
+  int pending = atomic_load(&list->pending);
+  int freed = 0;
+  while (freed < pending && list->retired[freed].epoch < oldest)
+    free(list->retired[freed++].node);
+
+  memmove(list->retired, list->retired + freed,
+          (pending - freed) * sizeof(struct _clrcu_retired));
+  atomic_store(&list->pending, pending - freed);
+
+  // While a reader holds nodes back, try again only once as many
+  // more have been retired, so that each retirement costs amortized
+  // constant time
+  list->reclaim_at = 2 * (pending - freed);
+  if (list->reclaim_at < CLRCU_RECLAIM_BATCH)
+    list->reclaim_at = CLRCU_RECLAIM_BATCH;
+}
+
+
+
+/*
+ * Retire a node that has been unlinked from the list, to be freed
+ * once no reader can be on it. The writer lock must be held.
+ *
+ * Returns: None
+ */
+static void
+_CLRCU_retire(CListRCU list, struct _clrcu_node *node)
+{
+  int pending = atomic_load(&list->pending);
+  if (pending == list->max_retired) {
+    list->max_retired *= 2;
+    list->retired = (struct _clrcu_retired *)
+      realloc(list->retired, list->max_retired * sizeof(struct _clrcu_retired));
+    assert(list->retired);
+  }
+
+  // Readers that start after this see the list without the node
+  list->retired[pending].epoch = atomic_fetch_add(&list->epoch, 1);
+  list->retired[pending].node = node;
+  atomic_store(&list->pending, pending + 1);
+
+  if (pending + 1 >= list->reclaim_at)
+    _CLRCU_reclaim(list);
+}
+
+
+
+/*
+ * Find the link that points to the node at a position. The writer
+ * lock must be held.
+ *
+ * Parameters:
+ *   list     The list
+ *   pos      The position, in the range [0, length]
+ *
+ * Returns: The link
+ */
+static _Atomic(struct _clrcu_node *) *
+_CLRCU_link_at(CListRCU list, int pos)
+{
+  _Atomic(struct _clrcu_node *) *link = &list->head;
+  for (int i = 0; i < pos; i++)
+    link = &atomic_load_explicit(link, memory_order_relaxed)->next;
+  return link;
+}
+
+
+
+/*
+ * Link a new node in at a link. The writer lock must be held.
+ *
+ * Parameters:
+ *   list     The list
+ *   link     The link, in the list
+ *   element  The element for the new node
+ *
+ * Returns: None
+ */
+static void
+_CLRCU_link(CListRCU list, _Atomic(struct _clrcu_node *) *link,
+            CListElementType element)
+{
+  struct _clrcu_node *node =
+    (struct _clrcu_node *) malloc(sizeof(struct _clrcu_node));
+  assert(node);
+
+  struct _clrcu_node *next = atomic_load_explicit(link, memory_order_relaxed);
+  node->element = element;
+  atomic_init(&node->next, next);
+
+  // The release store publishes the node's fields with it
+  atomic_store_explicit(link, node, memory_order_release);
+  if (next == NULL)
+    list->tail = &node->next;
+  atomic_fetch_add(&list->length, 1);
+}
+
+
+
+/*
+ * Unlink the node at a link and retire it. The writer lock must be
+ * held.
+ *
+ * Parameters:
+ *   list     The list
+ *   link     The link, in the list, which must not be NULL
+ *
+ * Returns: The removed element
+ */
+static CListElementType
+_CLRCU_unlink(CListRCU list, _Atomic(struct _clrcu_node *) *link)
+{
+  struct _clrcu_node *node = atomic_load_explicit(link, memory_order_relaxed);
+  struct _clrcu_node *next =
+    atomic_load_explicit(&node->next, memory_order_relaxed);
+  CListElementType element = node->element;
+
+  // A reader on the node can still follow its next link
+  atomic_store_explicit(link, next, memory_order_release);
+  if (next == NULL)
+    list->tail = link;
+  atomic_fetch_sub(&list->length, 1);
+
+  _CLRCU_retire(list, node);
+  return element;
+}
+
+
+
+// Documented in .h file
+CListRCU CLRCU_new()
+{
+  CListRCU list = (CListRCU) malloc(sizeof(struct _cl_rcu));
+  assert(list);
+
+  atomic_init(&list->head, NULL);
+  atomic_init(&list->length, 0);
+  atomic_init(&list->epoch, 1);
+  pthread_mutex_init(&list->lock, NULL);
+  list->tail = &list->head;
+  list->max_retired = CLRCU_RECLAIM_BATCH;
+  list->reclaim_at = CLRCU_RECLAIM_BATCH;
+  list->retired = (struct _clrcu_retired *)
+    malloc(list->max_retired * sizeof(struct _clrcu_retired));
+  assert(list->retired);
+  atomic_init(&list->pending, 0);
+  for (int i = 0; i < CLRCU_MAX_READERS; i++)
+    atomic_init(&list->readers[i].epoch, 0);
+
+  return list;
+}
+
+
+
+// Documented in .h file
+void CLRCU_free(CListRCU list)
+{
+  if (list == NULL) return;
+
+  struct _clrcu_node *node = atomic_load(&list->head);
+  while (node != NULL) {
+    struct _clrcu_node *next = atomic_load(&node->next);
+    free(node);
+    node = next;
+  }
+  int pending = atomic_load(&list->pending);
+  for (int i = 0; i < pending; i++)
+    free(list->retired[i].node);
+  free(list->retired);
+
+  pthread_mutex_destroy(&list->lock);
+  free(list);
+}
+
+
+
+// Documented in .h file
+int CLRCU_length(CListRCU list)
+{
+  assert(list);
+  return atomic_load(&list->length);
+}
+
+
+
+// Documented in .h file
+void CLRCU_push(CListRCU list, CListElementType element)
+{
+  assert(list);
+
+  pthread_mutex_lock(&list->lock);
+  _CLRCU_link(list, &list->head, element);
+  pthread_mutex_unlock(&list->lock);
+}
+
+
+
+// Documented in .h file
+CListElementType CLRCU_pop(CListRCU list)
+{
+  assert(list);
+
+  pthread_mutex_lock(&list->lock);
+  CListElementType ret = INVALID_RETURN;
+  if (atomic_load_explicit(&list->head, memory_order_relaxed) != NULL)
+    ret = _CLRCU_unlink(list, &list->head);
+  pthread_mutex_unlock(&list->lock);
+
+  return ret;
+}
+
+
+
+// Documented in .h file
+void CLRCU_append(CListRCU list, CListElementType element)
+{
+  assert(list);
+
+  pthread_mutex_lock(&list->lock);
+  _CLRCU_link(list, list->tail, element);
+  pthread_mutex_unlock(&list->lock);
+}
+
+
+
+// Documented in .h file
+bool CLRCU_insert(CListRCU list, CListElementType element, int pos)
+{
+  assert(list);
+
+  pthread_mutex_lock(&list->lock);
+  int length = atomic_load(&list->length);
+  if (pos < 0)
+    pos = length + pos + 1;  // Convert negative index to positive
+  bool ok = (pos >= 0 && pos <= length);
+  if (ok) {
+    _Atomic(struct _clrcu_node *) *link =
+      (pos == length) ? list->tail : _CLRCU_link_at(list, pos);
+    _CLRCU_link(list, link, element);
+  }
+  pthread_mutex_unlock(&list->lock);
+
+  return ok;
+}
+
+
+
+// Documented in .h file
+CListElementType CLRCU_remove(CListRCU list, int pos)
+{
+  assert(list);
+
+  pthread_mutex_lock(&list->lock);
+  int length = atomic_load(&list->length);
+  if (pos < 0)
+    pos += length;  // Convert negative index to positive
+  CListElementType ret = INVALID_RETURN;
+  if (pos >= 0 && pos < length)
+    ret = _CLRCU_unlink(list, _CLRCU_link_at(list, pos));
+  pthread_mutex_unlock(&list->lock);
+
+  return ret;
+}
+
+
+
+// Documented in .h file
+CListElementType CLRCU_nth(CListRCU list, int pos)
+{
+  assert(list);
+
+  if (pos < 0) {
+    pos += atomic_load(&list->length);  // Handle negative indices
+    if (pos < 0) return INVALID_RETURN;  // Out of range
+  }
+
+  int slot = _CLRCU_read_begin(list);
+  struct _clrcu_node *node = atomic_load_explicit(&list->head,
+                                                  memory_order_acquire);
+  for (int i = 0; i < pos && node != NULL; i++)
+    node = atomic_load_explicit(&node->next, memory_order_acquire);
+  CListElementType ret = (node != NULL) ? node->element : INVALID_RETURN;
+  _CLRCU_read_end(list, slot);
+
+  return ret;
+}
+
+
+
+// Documented in .h file
+void CLRCU_foreach(CListRCU list, CL_foreach_callback callback, void *cb_data)
+{
+  assert(list);
+  assert(callback);
+
+  int slot = _CLRCU_read_begin(list);
+  int pos = 0;
+  struct _clrcu_node *node =
+    atomic_load_explicit(&list->head, memory_order_acquire);
+  while (node != NULL) {
+    struct _clrcu_node *next =
+      atomic_load_explicit(&node->next, memory_order_acquire);
+    callback(pos++, node->element, cb_data);
+    node = next;
+  }
+  _CLRCU_read_end(list, slot);
+}
+
+
+
+// Documented in .h file
+CList CLRCU_copy(CListRCU list)
+{
+  assert(list);
+
+  // CL_push is constant time, so build the copy backwards and turn it
+  // round
+  CList copy = CL_new();
+  int slot = _CLRCU_read_begin(list);
+  for (struct _clrcu_node *node =
+         atomic_load_explicit(&list->head, memory_order_acquire);
+       node != NULL;
+       node = atomic_load_explicit(&node->next, memory_order_acquire))
+    CL_push(copy, node->element);
+  _CLRCU_read_end(list, slot);
+  CL_reverse(copy);
+
+  return copy;
+}
+
+
+
+// Documented in .h file
+void CLRCU_reclaim(CListRCU list)
+{
+  assert(list);
+
+  pthread_mutex_lock(&list->lock);
+  _CLRCU_reclaim(list);
+  pthread_mutex_unlock(&list->lock);
+}
+
+
+
+// Documented in .h file
+int CLRCU_pending(CListRCU list)
+{
+  assert(list);
+  return atomic_load(&list->pending);
+}
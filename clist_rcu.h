@@ -0,0 +1,128 @@
+/*
+ * clist_rcu.h
+ *
+ * RCU list: a CList that threads can read without taking a lock while
+ * another thread changes it, in the style of read-copy-update.
+ *
+ * Writers take a lock among themselves, and publish each change with
+ * a single atomic store to a link, so a reader walking the list never
+ * sees a half-made change. A removed node is not freed at once: it is
+ * retired, and freed only once every reader that might still be on
+ * it has finished. Readers (CLRCU_nth, CLRCU_foreach, CLRCU_copy)
+ * therefore never wait for a writer, and never see freed memory.
+ *
+ * A reader sees every element that is in the list throughout its
+ * walk; an element added or removed during the walk may or may not be
+ * seen.
+ *
+ * Every function behaves exactly like its CL_ counterpart in clist.h,
+ * except where noted. All functions may be called from any thread,
+ * except CLRCU_free.
+ */
+
+#ifndef _CLIST_RCU_H_
+#define _CLIST_RCU_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "clist.h"
+
+// Most threads that can be reading a list at once; more wait for
+// one of them to finish
+#ifndef CLRCU_MAX_READERS
+#define CLRCU_MAX_READERS 64
+#endif
+
+// struct _cl_rcu is defined in .c file
+typedef struct _cl_rcu *CListRCU;
+
+
+/*
+ * Create a new, empty RCU list
+ *
+ * Parameters: None
+ *
+ * Returns: The new list
+ */
+CListRCU CLRCU_new();
+
+
+/*
+ * Destroy an RCU list, calling free() on all malloc'd memory,
+ * including retired nodes. No thread may be using the list.
+ *
+ * Parameters:
+ *   list     The list; if NULL, no action will occur
+ *
+ * Returns: None
+ */
+void CLRCU_free(CListRCU list);
+
+
+// As CL_length
+int CLRCU_length(CListRCU list);
+
+
+// As CL_push
+void CLRCU_push(CListRCU list, CListElementType element);
+
+
+// As CL_pop
+CListElementType CLRCU_pop(CListRCU list);
+
+
+// As CL_append, but takes constant time
+void CLRCU_append(CListRCU list, CListElementType element);
+
+
+// As CL_insert
+bool CLRCU_insert(CListRCU list, CListElementType element, int pos);
+
+
+// As CL_remove
+CListElementType CLRCU_remove(CListRCU list, int pos);
+
+
+// As CL_nth. Does not wait for writers.
+CListElementType CLRCU_nth(CListRCU list, int pos);
+
+
+/*
+ * As CL_foreach. Does not wait for writers, who may change the list
+ * while the callback runs. The callback may call any function on the
+ * list, including ones that change it.
+ */
+void CLRCU_foreach(CListRCU list, CL_foreach_callback callback, void *cb_data);
+
+
+/*
+ * Copy the elements of the list into a new CList. Does not wait for
+ * writers.
+ *
+ * Parameters:
+ *   list     The list
+ *
+ * Returns: The new CList, which the caller must CL_free
+ */
+CList CLRCU_copy(CListRCU list);
+
+
+/*
+ * Free the retired nodes that no reader can still be on. Writers do
+ * this themselves once enough nodes have been retired, so this need
+ * only be called to release memory sooner.
+ *
+ * Parameters:
+ *   list     The list
+ *
+ * Returns: None
+ */
+void CLRCU_reclaim(CListRCU list);
+
+
+// Returns the number of nodes removed from the list but not yet freed
+int CLRCU_pending(CListRCU list);
+
+
+#endif /* _CLIST_RCU_H_ */
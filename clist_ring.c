@@ -0,0 +1,182 @@
+/*
+ * clist_ring.c
+ *
+ * Ring list, stored in a fixed-size circular array
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "clist_ring.h"
+
+struct _cl_ring {
+  CListElementType *elements;   // capacity slots, used circularly
+  int capacity;
+  int first;                    // slot of the element at position 0
+  int length;
+  CListRingPolicy policy;
+};
+
+
+
+/*
+ * Find the slot holding a position of the ring
+ *
+ * Parameters:
+ *   ring     The ring
+ *   pos      The position, in the range [0, capacity-1]
+ *
+ * Returns: The index of the slot
+ */
+static inline int
+_CLR_slot(CListRing ring, int pos)
+{
+  int slot = ring->first + pos;
+  return (slot >= ring->capacity) ? slot - ring->capacity : slot;
+}
+
+
+
+// Documented in .h file
+CListRing CLR_new(int capacity, CListRingPolicy policy)
+{
+  assert(capacity > 0);
+
+  CListRing ring = (CListRing) malloc(sizeof(struct _cl_ring));
+  assert(ring);
+  ring->elements =
+    (CListElementType *) malloc(capacity * sizeof(*ring->elements));
+  assert(ring->elements);
+
+  ring->capacity = capacity;
+  ring->first = 0;
+  ring->length = 0;
+  ring->policy = policy;
+
+  return ring;
+}
+
+
+
+// Documented in .h file
+void CLR_free(CListRing ring)
+{
+  if (ring == NULL) return;
+
+  free(ring->elements);
+  free(ring);
+}
+
+
+
+// Documented in .h file
+int CLR_length(CListRing ring)
+{
+  assert(ring);
+  return ring->length;
+}
+
+
+
+// Documented in .h file
+int CLR_capacity(CListRing ring)
+{
+  assert(ring);
+  return ring->capacity;
+}
+
+
+
+// Documented in .h file
+void CLR_print(CListRing ring)
+{
+  assert(ring);
+
+  for (int pos = 0; pos < ring->length; pos++)
+    printf("  [%d]: %s\n", pos, ring->elements[_CLR_slot(ring, pos)]);
+}
+
+
+
+// Documented in .h file
+bool CLR_push(CListRing ring, CListElementType element)
+{
+  assert(ring);
+
+  if (ring->length == ring->capacity) {
+    if (ring->policy == CLR_REJECT)
+      return false;
+    ring->length--;  // The last element is overwritten below
+  }
+
+  ring->first = (ring->first == 0) ? ring->capacity - 1 : ring->first - 1;
+  ring->elements[ring->first] = element;
+  ring->length++;
+
+  return true;
+}
+
+
+
+// Documented in .h file
+CListElementType CLR_pop(CListRing ring)
+{
+  assert(ring);
+
+  if (ring->length == 0)
+    return INVALID_RETURN;
+
+  CListElementType ret = ring->elements[ring->first];
+  ring->first = _CLR_slot(ring, 1);
+  ring->length--;
+
+  return ret;
+}
+
+
+
+// Documented in .h file
+bool CLR_append(CListRing ring, CListElementType element)
+{
+  assert(ring);
+
+  if (ring->length == ring->capacity) {
+    if (ring->policy == CLR_REJECT)
+      return false;
+    // Drop the first element; its slot is the one written below
+    ring->first = _CLR_slot(ring, 1);
+    ring->length--;
+  }
+
+  ring->elements[_CLR_slot(ring, ring->length)] = element;
+  ring->length++;
+
+  return true;
+}
+
+
+
+// Documented in .h file
+CListElementType CLR_nth(CListRing ring, int pos)
+{
+  assert(ring);
+
+  if (pos < 0)
+    pos += ring->length;  // Handle negative indices
+  if (pos < 0 || pos >= ring->length)
+    return INVALID_RETURN;  // Out of range
+
+  return ring->elements[_CLR_slot(ring, pos)];
+}
+
+
+
+// Documented in .h file
+void CLR_foreach(CListRing ring, CL_foreach_callback callback, void *cb_data)
+{
+  assert(ring);
+
+  for (int pos = 0; pos < ring->length; pos++)
+    callback(pos, ring->elements[_CLR_slot(ring, pos)], cb_data);
+}
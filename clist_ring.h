@@ -0,0 +1,106 @@
+/*
+ * clist_ring.h
+ *
+ * Ring list: a CList of fixed capacity, stored in a circular array.
+ *
+ * Adding or removing an element at either end and reading the element
+ * at any position take constant time, and no memory is allocated once
+ * the ring has been created, which suits bounded FIFOs such as log
+ * buffers and sliding windows. When the ring is full, adding an
+ * element either fails or overwrites the element at the other end,
+ * depending on the ring's policy.
+ *
+ * Every function behaves exactly like its CL_ counterpart in clist.h,
+ * except where noted.
+ */
+
+#ifndef _CLIST_RING_H_
+#define _CLIST_RING_H_
+
+#include <stdbool.h>
+
+#include "clist.h"
+
+// struct _cl_ring is defined in .c file
+typedef struct _cl_ring *CListRing;
+
+// What adding an element to a full ring does
+typedef enum {
+  CLR_REJECT,       // Leave the ring unchanged and report failure
+  CLR_OVERWRITE,    // Drop the element at the other end to make room
+} CListRingPolicy;
+
+
+/*
+ * Create a new, empty ring list
+ *
+ * Parameters:
+ *   capacity   The largest number of elements the ring can hold; must
+ *              be greater than 0
+ *   policy     What adding an element to a full ring does
+ *
+ * Returns: The new ring
+ */
+CListRing CLR_new(int capacity, CListRingPolicy policy);
+
+
+/*
+ * Destroy a ring list, calling free() on all malloc'd memory.
+ *
+ * Parameters:
+ *   ring   The ring; if NULL, no action will occur
+ *
+ * Returns: None
+ */
+void CLR_free(CListRing ring);
+
+
+// As CL_length
+int CLR_length(CListRing ring);
+
+// Returns the largest number of elements the ring can hold
+int CLR_capacity(CListRing ring);
+
+// As CL_print
+void CLR_print(CListRing ring);
+
+
+/*
+ * As CL_push. If the ring is full, CLR_OVERWRITE drops the last
+ * element to make room, and CLR_REJECT leaves the ring unchanged.
+ *
+ * Parameters:
+ *   ring     The ring
+ *   element  The element to add
+ *
+ * Returns: true if the element was added, false if it was rejected
+ */
+bool CLR_push(CListRing ring, CListElementType element);
+
+
+// As CL_pop
+CListElementType CLR_pop(CListRing ring);
+
+
+/*
+ * As CL_append. If the ring is full, CLR_OVERWRITE drops the first
+ * (oldest) element to make room, and CLR_REJECT leaves the ring
+ * unchanged.
+ *
+ * Parameters:
+ *   ring     The ring
+ *   element  The element to add
+ *
+ * Returns: true if the element was added, false if it was rejected
+ */
+bool CLR_append(CListRing ring, CListElementType element);
+
+
+// As CL_nth; runs in constant time for any position
+CListElementType CLR_nth(CListRing ring, int pos);
+
+// As CL_foreach
+void CLR_foreach(CListRing ring, CL_foreach_callback callback, void *cb_data);
+
+
+#endif /* _CLIST_RING_H_ */
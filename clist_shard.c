@@ -0,0 +1,219 @@
+/*
+ * clist_shard.c
+ *
+ * Sharded list: one CList per appending thread, each guarded by a
+ * flag of its own
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdatomic.h>
+
+#include "clist_shard.h"
+
+// Size of a cache line. Each shard's flag is given one to itself, as
+// CL_new gives each list's header.
+#define CLS_CACHE_LINE 64
+
+struct _cls_shard {
+  _Alignas(CLS_CACHE_LINE) atomic_flag busy;  // set while the list is in use
+  CList list;
+};
+
+struct _cl_shards {
+  struct _cls_shard *shards;
+  int num_shards;
+};
+
+// Hands out thread numbers, from which threads' shards are chosen
+static atomic_uint _CLS_next_thread = 0;
+
+// The calling thread's number plus one, or 0 if it has none yet
+static _Thread_local unsigned _CLS_thread = 0;
+
+
+
+/*
+ * Take a shard's flag, waiting while another thread holds it. Only a
+ * collect, or a thread that shares the shard, can be holding it.
+ *
+ * Returns: The shard's list
+ */
+static CList
+_CLS_lock(struct _cls_shard *shard)
+{
+  while (atomic_flag_test_and_set_explicit(&shard->busy, memory_order_acquire))
+    sched_yield();
+  return shard->list;
+}
+
+
+
+// Release a shard's flag, taken by _CLS_lock
+static void
+_CLS_unlock(struct _cls_shard *shard)
+{
+  atomic_flag_clear_explicit(&shard->busy, memory_order_release);
+}
+
+
+
+/*
+ * Move the elements of every shard onto lists of their own, holding
+ * each shard's flag only while its elements are moved
+ *
+ * Parameters:
+ *   shards   The sharded list
+ *
+ * Returns: A malloc'd array of num_shards new lists, which the caller
+ *   must free
+ */
+static CList *
+_CLS_take_all(CListShards shards)
+{
+  CList *lists = (CList *) malloc(shards->num_shards * sizeof(CList));
+  assert(lists);
+
+  for (int i = 0; i < shards->num_shards; i++) {
+    lists[i] = CL_new();
+    CL_join(lists[i], _CLS_lock(&shards->shards[i]));
+    _CLS_unlock(&shards->shards[i]);
+  }
+  return lists;
+}
+
+
+
+// Documented in .h file
+CListShards CLS_new(int num_shards)
+{
+  assert(num_shards > 0);
+
+  CListShards shards = (CListShards) malloc(sizeof(struct _cl_shards));
+  assert(shards);
+  shards->shards = (struct _cls_shard *)
+    aligned_alloc(CLS_CACHE_LINE, num_shards * sizeof(struct _cls_shard));
+  assert(shards->shards);
+  shards->num_shards = num_shards;
+
+  for (int i = 0; i < num_shards; i++) {
+    atomic_flag_clear(&shards->shards[i].busy);
+    shards->shards[i].list = CL_new();
+  }
+  return shards;
+}
+
+
+
+// Documented in .h file
+void CLS_free(CListShards shards)
+{
+  if (shards == NULL) return;
+
+  for (int i = 0; i < shards->num_shards; i++)
+    CL_free(shards->shards[i].list);
+  free(shards->shards);
+  free(shards);
+}
+
+
+
+// Documented in .h file
+int CLS_num_shards(CListShards shards)
+{
+  assert(shards);
+  return shards->num_shards;
+}
+
+
+
+// Documented in .h file
+int CLS_length(CListShards shards)
+{
+  assert(shards);
+
+  size_t length = 0;
+  for (int i = 0; i < shards->num_shards; i++) {
+    length += CL_length_z(_CLS_lock(&shards->shards[i]));
+    _CLS_unlock(&shards->shards[i]);
+  }
+  return (length > INT_MAX) ? INT_MAX : (int) length;
+}
+
+
+
+// Documented in .h file
+void CLS_append(CListShards shards, CListElementType element)
+{
+  assert(shards);
+
+  if (_CLS_thread == 0)
+    _CLS_thread = atomic_fetch_add(&_CLS_next_thread, 1) + 1;
+  CLS_append_to(shards, (_CLS_thread - 1) % shards->num_shards, element);
+}
+
+
+
+// Documented in .h file
+void CLS_append_to(CListShards shards, int shard, CListElementType element)
+{
+  assert(shards);
+  assert(shard >= 0 && shard < shards->num_shards);
+
+  CL_append(_CLS_lock(&shards->shards[shard]), element);
+  _CLS_unlock(&shards->shards[shard]);
+}
+
+
+
+// Documented in .h file
+CList CLS_collect(CListShards shards)
+{
+  assert(shards);
+
+  CList collected = CL_new();
+  for (int i = 0; i < shards->num_shards; i++) {
+    CL_join(collected, _CLS_lock(&shards->shards[i]));
+    _CLS_unlock(&shards->shards[i]);
+  }
+  return collected;
+}
+
+
+
+// Documented in .h file
+CList CLS_collect_sorted(CListShards shards)
+{
+  assert(shards);
+
+  CList *lists = _CLS_take_all(shards);
+  for (int i = 0; i < shards->num_shards; i++)
+    CL_sort_radix(lists[i]);
+  CList collected = CL_merge_sorted_k(lists, shards->num_shards);
+
+  for (int i = 0; i < shards->num_shards; i++)
+    CL_free(lists[i]);
+  free(lists);
+  return collected;
+}
+
+
+
+// Documented in .h file
+CList CLS_collect_sorted_cmp(CListShards shards, CL_compare_fn cmp)
+{
+  assert(shards);
+  assert(cmp);
+
+  CList *lists = _CLS_take_all(shards);
+  for (int i = 0; i < shards->num_shards; i++)
+    CL_sort_cmp(lists[i], cmp);
+  CList collected = CL_merge_sorted_k_cmp(lists, shards->num_shards, cmp);
+
+  for (int i = 0; i < shards->num_shards; i++)
+    CL_free(lists[i]);
+  free(lists);
+  return collected;
+}
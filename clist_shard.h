@@ -0,0 +1,117 @@
+/*
+ * clist_shard.h
+ *
+ * Sharded list: a set of CLists, one per appending thread, for
+ * ingesting elements from many threads at once. Each thread appends
+ * to a shard of its own, so appending threads do not wait for each
+ * other; the shards are then collected into a single CList, by
+ * joining them in constant time per shard, or by merging them in
+ * sorted order.
+ *
+ * All functions may be called from any thread, except CLS_free.
+ * Elements appended while a collect runs may or may not be included
+ * in it; if not, they are left for the next one.
+ */
+
+#ifndef _CLIST_SHARD_H_
+#define _CLIST_SHARD_H_
+
+#include "clist.h"
+
+// struct _cl_shards is defined in .c file
+typedef struct _cl_shards *CListShards;
+
+
+/*
+ * Create a new, empty sharded list
+ *
+ * Parameters:
+ *   num_shards   The number of shards; must be greater than 0. With
+ *                at least as many shards as appending threads, no two
+ *                threads share a shard.
+ *
+ * Returns: The new sharded list
+ */
+CListShards CLS_new(int num_shards);
+
+
+/*
+ * Destroy a sharded list, calling free() on all malloc'd memory. No
+ * thread may be using it.
+ *
+ * Parameters:
+ *   shards   The sharded list; if NULL, no action will occur
+ *
+ * Returns: None
+ */
+void CLS_free(CListShards shards);
+
+
+// Returns the number of shards
+int CLS_num_shards(CListShards shards);
+
+
+// Returns the number of elements in all the shards
+int CLS_length(CListShards shards);
+
+
+/*
+ * Add an element to the end of the calling thread's shard. Threads
+ * are given shards in turn, the first time they append. Takes
+ * constant time.
+ *
+ * Parameters:
+ *   shards   The sharded list
+ *   element  The element to add
+ *
+ * Returns: None
+ */
+void CLS_append(CListShards shards, CListElementType element);
+
+
+/*
+ * Add an element to the end of a given shard. Takes constant time.
+ *
+ * Parameters:
+ *   shards   The sharded list
+ *   shard    The shard, in the range [0, num_shards)
+ *   element  The element to add
+ *
+ * Returns: None
+ */
+void CLS_append_to(CListShards shards, int shard, CListElementType element);
+
+
+/*
+ * Move every element into a new CList: the elements of shard 0, in
+ * the order they were appended, then those of shard 1, and so on.
+ * Nodes are relinked, not copied, as CL_join, so this takes time
+ * proportional to the number of shards, not of elements. The shards
+ * are left empty.
+ *
+ * Parameters:
+ *   shards   The sharded list
+ *
+ * Returns: The new CList, which the caller must CL_free
+ */
+CList CLS_collect(CListShards shards);
+
+
+/*
+ * Move every element into a new CList in sorted order. Each shard is
+ * sorted with CL_sort_radix, outside the shard's lock, and the shards
+ * are then merged as CL_merge_sorted_k. The shards are left empty.
+ *
+ * Parameters:
+ *   shards   The sharded list
+ *
+ * Returns: The new CList, which the caller must CL_free
+ */
+CList CLS_collect_sorted(CListShards shards);
+
+
+// As CLS_collect_sorted, but sorting with CL_sort_cmp and cmp
+CList CLS_collect_sorted_cmp(CListShards shards, CL_compare_fn cmp);
+
+
+#endif /* _CLIST_SHARD_H_ */
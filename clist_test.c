@@ -15,8 +15,20 @@
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
 
 #include "./clist.h"
+#include "./clist_compact.h"
+#include "./clist_pq.h"
+#include "./clist_ring.h"
+#include "./clist_queue.h"
+#include "./clist_trace.h"
+#include "./clist_rcu.h"
+#include "./clist_shard.h"
 
 
 // Define the INVALID_RETURN for the tests that use it
@@ -158,6 +170,7 @@ int test_cl_append()
 {
   int ret = 0;
   CList list = CL_new();
+  CList other = NULL;
   
   // Append all the items
   for (int i=0; i < num_testdata; i++) {
@@ -169,10 +182,32 @@ int test_cl_append()
   for (int i=0; i < num_testdata; i++)
     test_compare( CL_nth(list, i), testdata[i] );
 
+  // appends still go to the end after the end has changed
+  CL_remove(list, -1);
+  CL_append(list, "Last");
+  test_compare( CL_nth(list, -1), "Last" );
+  CL_sort(list);
+  CL_append(list, "After sort");
+  test_compare( CL_nth(list, -1), "After sort" );
+  other = CL_split(list, 5);
+  CL_append(list, "After split");
+  test_compare( CL_nth(list, 5), "After split" );
+  CL_join(list, other);
+  CL_append(list, "After join");
+  CL_append(other, "Other");
+  test_compare( CL_nth(list, -1), "After join" );
+  test_assert( CL_length(list) == num_testdata + 3 );
+  test_assert( CL_length(other) == 1 );
+  while (CL_length(other) > 0)
+    CL_pop(other);
+  CL_append(other, "Only");
+  test_compare( CL_nth(other, 0), "Only" );
+
   ret = 1;
 
  test_error:
   CL_free(list);
+  CL_free(other);
   return ret;
 }
 
@@ -237,6 +272,7 @@ int sample_clist_usage()
 {
   int ret = 0;
   CList list = CL_new();
+  CList list_copy = NULL;
 
   // new lists have length 0
   test_assert( CL_length(list) == 0 );
@@ -275,7 +311,7 @@ int sample_clist_usage()
   // list is now: bravo, alpha, delta, echo
 
   // make a copy of the list
-  CList list_copy = CL_copy(list);
+  list_copy = CL_copy(list);
 
   test_assert( CL_length(list_copy) == 4 );
 
@@ -526,22 +562,2144 @@ int test_CL_foreach() {
 
 
 
+/*
+ * Tests the CL_insert_sorted and CL_find_sorted functions
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_insert_sorted()
+{
+  int ret = 0;
+  CList list = CL_new();
 
-int main() {
-  int passed = 0;
-  int num_tests = 0;
+  test_assert( CL_find_sorted(list, testdata[0]) == -1 );
 
-  passed += run_test(test_cl_push_pop, "test_cl_push_pop");
-  passed += run_test(test_cl_append, "test_cl_append");
-  passed += run_test(test_cl_nth, "test_cl_nth");
-  passed += run_test(sample_clist_usage, "sample_clist_usage");
-  passed += run_test(test_CL_insert, "test_CL_insert");
-  passed += run_test(test_CL_remove, "test_CL_remove");
-  passed += run_test(test_CL_copy, "test_CL_copy");
-  passed += run_test(test_CL_reverse, "test_CL_reverse");
-  passed += run_test(test_CL_foreach, "test_CL_foreach");
+  for (int i=0; i < num_testdata; i++) {
+    int pos = CL_insert_sorted(list, testdata[i]);
+    test_compare( CL_nth(list, pos), testdata[i] );
+    test_assert( CL_length(list) == i+1 );
+  }
+
+  for (int i=0; i < num_testdata; i++) {
+    test_compare( CL_nth(list, i), testdata_sorted[i] );
+    test_assert( CL_find_sorted(list, testdata_sorted[i]) == i );
+  }
+
+  test_assert( CL_find_sorted(list, "Aardvark") == -1 );
+  test_assert( CL_find_sorted(list, "Nine and a half") == -1 );
+  test_assert( CL_find_sorted(list, "Zulu") == -1 );
+
+  // Equal elements are inserted after those already on the list
+  test_assert( CL_insert_sorted(list, "Five") == 5 );
+  test_assert( CL_find_sorted(list, "Five") == 4 );
+
+  ret = 1;
+
+ test_error:
+  CL_free(list);
+  return ret;
+}
+
+
+/*
+ * Tests the CL_sort and CL_sort_cmp functions, with and without
+ * cached keys
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_sort()
+{
+  int ret = 0;
+  CList list = CL_new();
+  CList keyed = CL_new();
+  CL_set_key(keyed, strcmp, CL_key_prefix);
+
+  CL_sort(list);
+  test_assert( CL_length(list) == 0 );
+
+  for (int i=0; i < num_testdata; i++) {
+    CL_append(list, testdata[i]);
+    CL_push(keyed, testdata[i]);
+  }
+
+  CL_sort(list);
+  CL_sort(keyed);
+  test_assert( CL_length(list) == num_testdata );
+  test_assert( CL_length(keyed) == num_testdata );
+  for (int i=0; i < num_testdata; i++) {
+    test_compare( CL_nth(list, i), testdata_sorted[i] );
+    test_compare( CL_nth(keyed, i), testdata_sorted[i] );
+  }
+
+  // Sorting a sorted list leaves it unchanged
+  CL_sort_cmp(list, strcmp);
+  for (int i=0; i < num_testdata; i++)
+    test_compare( CL_nth(list, i), testdata_sorted[i] );
+
+  ret = 1;
+
+ test_error:
+  CL_free(list);
+  CL_free(keyed);
+  return ret;
+}
+
+
+// Orders numeric strings by value
+static int compare_numeric(const char *a, const char *b)
+{
+  long x = strtol(a, NULL, 10);
+  long y = strtol(b, NULL, 10);
+  return (x > y) - (x < y);
+}
+
+// Key function consistent with compare_numeric for values >= 0
+static uint64_t key_numeric(const char *element)
+{
+  return (uint64_t) strtol(element, NULL, 10);
+}
+
+
+/*
+ * Tests CL_sort_radix against CL_sort, on strings with long shared
+ * prefixes, duplicates, empty strings and bytes above 0x7f
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_sort_radix()
+{
+  int ret = 0;
+  const char *prefixes[] = {"abc", "", "abcdefgh", "ab", "abcdefghij", "a",
+    "abcdefghi", "abd", "abcdefgh", ""};
+  const int num_prefixes = sizeof(prefixes) / sizeof(prefixes[0]);
+  CList list = CL_new();
+  CList sorted = NULL;
+  char *block = (char *) malloc(200 * 80);
+  int pos;
+
+  CL_sort_radix(list);
+  test_assert( CL_length(list) == 0 );
+
+  // "b", "ab", "aab", ... splits one element off at each level, and
+  // repeats of the same strings must keep their order
+  for (int n = 0; n < 200; n++) {
+    char *s = block + 80 * n;
+    int len = (n % 100 < 70) ? n % 70 : (n * 7) % 5;
+    memset(s, 'a', len);
+    s[len] = (n % 3 == 0) ? 'b' : (n % 3 == 1) ? '\xe9' : '\0';
+    s[len + 1] = '\0';
+    CL_append(list, s);
+  }
+  for (pos = 0; pos < num_testdata; pos++)
+    CL_push(list, testdata[pos]);
+
+  sorted = CL_copy(list);
+  CL_sort(sorted);
+  CL_sort_radix(list);
+  test_assert( CL_length(list) == CL_length(sorted) );
+  for (pos = 0; pos < CL_length(list); pos++)
+    test_assert( CL_nth(list, pos) == CL_nth(sorted, pos) );
+
+  // Sorting a sorted list, with prefix keys cached
+  CL_set_key(list, CL_strcmp, CL_key_prefix);
+  CL_sort_radix(list);
+  for (pos = 0; pos < CL_length(list); pos++)
+    test_assert( CL_nth(list, pos) == CL_nth(sorted, pos) );
+  test_assert( CL_find_sorted(list, "Twenty") >= 0 );
+  CL_free(list);
+  CL_free(sorted);
+  sorted = NULL;
+
+  // Keys that are proper prefixes of others, ending at the depth of
+  // a bucket pass, go first in their bucket
+  list = CL_new();
+  for (int n = 0; n < 400; n++)
+    CL_append(list, prefixes[(n * 7) % num_prefixes]);
+  sorted = CL_copy(list);
+  CL_sort(sorted);
+  CL_sort_radix(list);
+  test_assert( CL_length(list) == 400 );
+  test_compare( CL_nth(list, 0), "" );
+  for (pos = 0; pos < 400; pos++)
+    test_assert( CL_nth(list, pos) == CL_nth(sorted, pos) );
+
+  ret = 1;
+
+ test_error:
+  CL_free(list);
+  CL_free(sorted);
+  free(block);
+  return ret;
+}
+
+
+/*
+ * Tests the sorted operations with user-supplied comparators and key
+ * functions
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_sorted_cmp()
+{
+  int ret = 0;
+  CList nocase = CL_new();
+  CList numeric = CL_new();
+  const char *words[] = {"delta", "Alpha", "charlie", "ALPHAbet", "Bravo"};
+  const char *words_sorted[] = {"Alpha", "ALPHAbet", "Bravo", "charlie",
+    "delta"};
+  const char *numbers[] = {"100", "7", "42", "7", "1000", "0"};
+  const char *numbers_sorted[] = {"0", "7", "7", "42", "100", "1000"};
+
+  // Keys turned on before the elements are added
+  CL_set_key(nocase, strcasecmp, CL_key_prefix_nocase);
+  for (int i=0; i < 5; i++)
+    CL_insert_sorted_cmp(nocase, words[i], strcasecmp);
+  for (int i=0; i < 5; i++)
+    test_compare( CL_nth(nocase, i), words_sorted[i] );
+  test_assert( CL_find_sorted_cmp(nocase, "CHARLIE", strcasecmp) == 3 );
+  test_assert( CL_find_sorted_cmp(nocase, "echo", strcasecmp) == -1 );
+
+  // Keys turned on after the elements are added
+  for (int i=0; i < 6; i++)
+    CL_append(numeric, numbers[i]);
+  CL_set_key(numeric, compare_numeric, key_numeric);
+  CL_sort_cmp(numeric, compare_numeric);
+  for (int i=0; i < 6; i++)
+    test_compare( CL_nth(numeric, i), numbers_sorted[i] );
+  test_assert( CL_insert_sorted_cmp(numeric, "50", compare_numeric) == 4 );
+  test_assert( CL_find_sorted_cmp(numeric, "1000", compare_numeric) == 6 );
+
+  // Turning keys off leaves the list usable with any comparator
+  CL_set_key(numeric, NULL, NULL);
+  test_assert( CL_find_sorted_cmp(numeric, "42", compare_numeric) == 3 );
+
+  ret = 1;
+
+ test_error:
+  CL_free(nocase);
+  CL_free(numeric);
+  return ret;
+}
+
+
+/*
+ * Tests the CL_merge_sorted and CL_merge_sorted_cmp functions
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_merge_sorted()
+{
+  int ret = 0;
+  CList list1 = CL_new();
+  CList list2 = CL_new();
+
+  // Even entries to one list, odd entries to the other
+  for (int i=0; i < num_testdata; i++)
+    CL_append(i % 2 ? list2 : list1, testdata_sorted[i]);
+
+  CL_merge_sorted(list1, list2);
+  test_assert( CL_length(list1) == num_testdata );
+  test_assert( CL_length(list2) == 0 );
+  for (int i=0; i < num_testdata; i++)
+    test_compare( CL_nth(list1, i), testdata_sorted[i] );
+
+  // Merging with an empty list, in either direction
+  CL_merge_sorted(list1, list2);
+  test_assert( CL_length(list1) == num_testdata );
+  CL_merge_sorted(list2, list1);
+  test_assert( CL_length(list2) == num_testdata );
+  test_assert( CL_length(list1) == 0 );
+
+  // Keys of the merged nodes are recomputed for the receiving list
+  CL_set_key(list1, strcmp, CL_key_prefix);
+  CL_append(list1, "Fiver");
+  CL_append(list1, "Zeroes");
+  CL_merge_sorted_cmp(list1, list2, strcmp);
+  test_assert( CL_length(list1) == num_testdata + 2 );
+  test_assert( CL_find_sorted_cmp(list1, "Five", strcmp) == 4 );
+  test_assert( CL_find_sorted_cmp(list1, "Fiver", strcmp) == 5 );
+  test_compare( CL_nth(list1, -1), "Zeroes" );
+
+  ret = 1;
+
+ test_error:
+  CL_free(list1);
+  CL_free(list2);
+  return ret;
+}
+
+
+
+/*
+ * Tests the CL_intersect_sorted and CL_difference_sorted functions
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_set_ops()
+{
+  int ret = 0;
+  CList list1 = CL_new();
+  CList list2 = CL_new();
+  CList diff = NULL;
+  const char *a[] = {"alpha", "bravo", "bravo", "bravo", "delta", "echo"};
+  const char *b[] = {"bravo", "bravo", "charlie", "echo", "foxtrot"};
+
+  for (int i=0; i < 6; i++)
+    CL_append(list1, a[i]);
+  for (int i=0; i < 5; i++)
+    CL_append(list2, b[i]);
+  diff = CL_copy(list1);
+
+  // Duplicates survive as many times as they appear in both lists
+  CL_intersect_sorted(list1, list2);
+  test_assert( CL_length(list1) == 3 );
+  test_compare( CL_nth(list1, 0), "bravo" );
+  test_compare( CL_nth(list1, 1), "bravo" );
+  test_compare( CL_nth(list1, 2), "echo" );
+  test_assert( CL_length(list2) == 5 );
+
+  CL_difference_sorted(diff, list2);
+  test_assert( CL_length(diff) == 3 );
+  test_compare( CL_nth(diff, 0), "alpha" );
+  test_compare( CL_nth(diff, 1), "bravo" );
+  test_compare( CL_nth(diff, 2), "delta" );
+  test_assert( CL_length(list2) == 5 );
+
+  // Against an empty list
+  CL_difference_sorted_cmp(list2, list1, strcmp);
+  CL_difference_sorted_cmp(list2, list1, strcmp);
+  test_assert( CL_length(list2) == 2 );
+  test_compare( CL_nth(list2, 0), "charlie" );
+  test_compare( CL_nth(list2, 1), "foxtrot" );
+  CL_intersect_sorted_cmp(list1, diff, strcmp);
+  test_assert( CL_length(list1) == 1 );
+  CL_free(list1);
+  list1 = CL_new();
+  CL_intersect_sorted(diff, list1);
+  test_assert( CL_length(diff) == 0 );
+
+  ret = 1;
+
+ test_error:
+  CL_free(list1);
+  CL_free(list2);
+  CL_free(diff);
+  return ret;
+}
+
+
+/*
+ * Tests the CL_unique and CL_dedup functions
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_unique()
+{
+  int ret = 0;
+  CList list = CL_new();
+  const char *a[] = {"alpha", "alpha", "bravo", "charlie", "charlie",
+                     "charlie", "delta", "delta"};
+  const char *b[] = {"echo", "alpha", "echo", "bravo", "alpha", "echo",
+                     "charlie"};
+
+  test_assert( CL_unique(list) == 0 );
+  test_assert( CL_dedup(list) == 0 );
+
+  for (int i=0; i < 8; i++)
+    CL_append(list, a[i]);
+  test_assert( CL_unique(list) == 4 );
+  test_assert( CL_length(list) == 4 );
+  test_compare( CL_nth(list, 0), "alpha" );
+  test_compare( CL_nth(list, 1), "bravo" );
+  test_compare( CL_nth(list, 2), "charlie" );
+  test_compare( CL_nth(list, 3), "delta" );
+  test_assert( CL_unique_cmp(list, strcmp) == 0 );
+  test_assert( CL_length(list) == 4 );
+
+  // Equal under the comparator, though the strings differ
+  CL_free(list);
+  list = CL_new();
+  CL_set_key(list, strcasecmp, CL_key_prefix_nocase);
+  CL_append(list, "Alpha");
+  CL_append(list, "ALPHA");
+  CL_append(list, "alpha");
+  CL_append(list, "bravo");
+  test_assert( CL_unique_cmp(list, strcasecmp) == 2 );
+  test_assert( CL_length(list) == 2 );
+  test_compare( CL_nth(list, 0), "Alpha" );
+  test_compare( CL_nth(list, 1), "bravo" );
+
+  // Unsorted: first occurrences survive in their original order
+  CL_free(list);
+  list = CL_new();
+  for (int i=0; i < 7; i++)
+    CL_append(list, b[i]);
+  test_assert( CL_dedup(list) == 3 );
+  test_assert( CL_length(list) == 4 );
+  test_compare( CL_nth(list, 0), "echo" );
+  test_compare( CL_nth(list, 1), "alpha" );
+  test_compare( CL_nth(list, 2), "bravo" );
+  test_compare( CL_nth(list, 3), "charlie" );
+  test_assert( CL_dedup(list) == 0 );
+
+  // Nodes in a compacted block are released too
+  for (int i=0; i < 7; i++)
+    CL_append(list, b[i]);
+  CL_compact(list);
+  test_assert( CL_dedup(list) == 7 );
+  test_assert( CL_length(list) == 4 );
+  test_compare( CL_nth(list, 3), "charlie" );
+
+  ret = 1;
+
+ test_error:
+  CL_free(list);
+  return ret;
+}
+
+
+// Predicate for CL_remove_if: elements starting with the char at
+// cb_data
+static bool starts_with(CListElementType element, void *cb_data)
+{
+  return element[0] == *(char *) cb_data;
+}
+
+
+/*
+ * Tests CL_remove_if and CL_extract_if
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_remove_if()
+{
+  int ret = 0;
+  CList list = CL_new();
+  CList extracted = NULL;
+  char first = 'T';
+  int pos;
+
+  test_assert( CL_remove_if(list, starts_with, &first) == 0 );
+
+  // Two, Three, Ten, Twelve, Thirteen, Twenty
+  for (pos = 0; pos < num_testdata; pos++)
+    CL_append(list, testdata[pos]);
+  test_assert( CL_remove_if(list, starts_with, &first) == 6 );
+  test_assert( CL_length(list) == num_testdata - 6 );
+  test_compare( CL_nth(list, 0), "Zero" );
+  test_compare( CL_nth(list, 1), "One" );
+  test_compare( CL_nth(list, 2), "Four" );
+  test_compare( CL_nth(list, -1), "Nineteen" );
+  test_assert( CL_remove_if(list, starts_with, &first) == 0 );
+
+  // The extracted elements keep their order; the first and last go
+  first = 'Z';
+  CL_append(list, "Zulu");
+  CL_compact(list);
+  extracted = CL_extract_if(list, starts_with, &first);
+  test_assert( CL_length(extracted) == 2 );
+  test_compare( CL_nth(extracted, 0), "Zero" );
+  test_compare( CL_nth(extracted, 1), "Zulu" );
+  test_assert( CL_length(list) == num_testdata - 7 );
+  test_compare( CL_nth(list, 0), "One" );
+  test_compare( CL_nth(list, -1), "Nineteen" );
+
+  // Everything, from both lists
+  CL_join(list, extracted);
+  first = 'F';
+  test_assert( CL_remove_if(list, starts_with, &first) == 4 );
+  test_assert( CL_length(list) == num_testdata - 9 );
+  test_compare( CL_nth(list, -1), "Zulu" );
+  CL_free(extracted);
+  first = '\0';
+  extracted = CL_extract_if(list, starts_with, &first);
+  test_assert( CL_length(extracted) == 0 );
+
+  ret = 1;
+
+ test_error:
+  CL_free(list);
+  CL_free(extracted);
+  return ret;
+}
+
+
+/*
+ * Tests the priority queue functions
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_pq()
+{
+  int ret = 0;
+  CListPQ pq1 = PQ_new();
+  CListPQ pq2 = PQ_new();
+  CListPQ numbers = PQ_new_cmp(compare_numeric);
+  const char *a[] = {"delta", "alpha", "echo", "bravo", "alpha", "charlie"};
+  const char *b[] = {"golf", "able", "foxtrot"};
+
+  test_assert( PQ_length(pq1) == 0 );
+  test_invalid( PQ_peek_min(pq1) );
+  test_invalid( PQ_pop_min(pq1) );
+
+  for (int i=0; i < 6; i++)
+    PQ_push(pq1, a[i]);
+  test_assert( PQ_length(pq1) == 6 );
+  test_compare( PQ_peek_min(pq1), "alpha" );
+  test_compare( PQ_pop_min(pq1), "alpha" );
+  test_compare( PQ_pop_min(pq1), "alpha" );
+  test_compare( PQ_pop_min(pq1), "bravo" );
+  test_assert( PQ_length(pq1) == 3 );
+
+  // Meld moves every element of pq2 into pq1
+  for (int i=0; i < 3; i++)
+    PQ_push(pq2, b[i]);
+  PQ_meld(pq1, pq2);
+  PQ_meld(pq1, pq2);
+  test_assert( PQ_length(pq1) == 6 );
+  test_assert( PQ_length(pq2) == 0 );
+  test_invalid( PQ_pop_min(pq2) );
+  test_compare( PQ_pop_min(pq1), "able" );
+  test_compare( PQ_pop_min(pq1), "charlie" );
+  test_compare( PQ_pop_min(pq1), "delta" );
+  test_compare( PQ_pop_min(pq1), "echo" );
+  test_compare( PQ_pop_min(pq1), "foxtrot" );
+  test_compare( PQ_pop_min(pq1), "golf" );
+  test_invalid( PQ_pop_min(pq1) );
+
+  // Ordered by the comparator; the queue is freed with nodes in it
+  PQ_push(numbers, "100");
+  PQ_push(numbers, "9");
+  PQ_push(numbers, "25");
+  PQ_push(numbers, "3");
+  test_compare( PQ_pop_min(numbers), "3" );
+  test_compare( PQ_pop_min(numbers), "9" );
+  PQ_push(numbers, "1");
+  test_compare( PQ_peek_min(numbers), "1" );
+  test_assert( PQ_length(numbers) == 3 );
+
+  // Many elements, popped in between pushes, come out in order
+  static char values[500][8];
+  for (int i=0; i < 500; i++) {
+    snprintf(values[i], sizeof(values[i]), "%d", (i * 7919) % 1000);
+    PQ_push(numbers, values[i]);
+    if (i % 5 == 4)
+      PQ_pop_min(numbers);
+  }
+  test_assert( PQ_length(numbers) == 403 );
+  const char *prev = PQ_pop_min(numbers);
+  while (PQ_length(numbers) > 0) {
+    const char *next = PQ_pop_min(numbers);
+    test_assert( compare_numeric(prev, next) <= 0 );
+    prev = next;
+  }
+
+  ret = 1;
+
+ test_error:
+  PQ_free(pq1);
+  PQ_free(pq2);
+  PQ_free(numbers);
+  return ret;
+}
+
+
+/*
+ * Tests the CL_merge_sorted_k function
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_merge_sorted_k()
+{
+  int ret = 0;
+  CList lists[5];
+  CList merged = NULL;
+
+  for (int i=0; i < 5; i++)
+    lists[i] = CL_new();
+
+  test_assert( (merged = CL_merge_sorted_k(lists, 0)) != NULL );
+  test_assert( CL_length(merged) == 0 );
+  CL_free(merged);
+  merged = NULL;
+
+  // Deal the sorted data round-robin onto four lists, leave one empty
+  for (int i=0; i < num_testdata; i++)
+    CL_append(lists[i % 4], testdata_sorted[i]);
+  CL_set_key(lists[0], strcmp, CL_key_prefix);
+
+  merged = CL_merge_sorted_k(lists, 5);
+  test_assert( CL_length(merged) == num_testdata );
+  for (int i=0; i < num_testdata; i++)
+    test_compare( CL_nth(merged, i), testdata_sorted[i] );
+  for (int i=0; i < 5; i++)
+    test_assert( CL_length(lists[i]) == 0 );
+
+  // The result keeps lists[0]'s keys
+  test_assert( CL_insert_sorted(merged, "Sixty") == 14 );
+
+  ret = 1;
+
+ test_error:
+  for (int i=0; i < 5; i++)
+    CL_free(lists[i]);
+  CL_free(merged);
+  return ret;
+}
+
+
+
+/*
+ * Tests the CL_split function
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_split()
+{
+  int ret = 0;
+  CList list = CL_new();
+  CList tail = NULL;
+  CList empty = NULL;
+
+  for (int i=0; i < num_testdata; i++)
+    CL_append(list, testdata[i]);
+
+  test_assert( CL_split(list, num_testdata + 1) == NULL );
+  test_assert( CL_split(list, -num_testdata - 2) == NULL );
+
+  tail = CL_split(list, 15);
+  test_assert( CL_length(list) == 15 );
+  test_assert( CL_length(tail) == num_testdata - 15 );
+  test_compare( CL_nth(list, -1), testdata[14] );
+  for (int i=15; i < num_testdata; i++)
+    test_compare( CL_nth(tail, i - 15), testdata[i] );
+
+  // pos == -1 splits off nothing; pos == 0 splits off everything
+  empty = CL_split(tail, -1);
+  test_assert( CL_length(empty) == 0 );
+  CL_join(empty, tail);
+  CL_free(tail);
+  tail = CL_split(list, -16);
+  test_assert( CL_length(list) == 0 );
+  test_assert( CL_length(tail) == 15 );
+
+  // The halves are independent lists
+  CL_append(list, "alpha");
+  CL_join(tail, empty);
+  test_assert( CL_length(list) == 1 );
+  test_assert( CL_length(tail) == num_testdata );
+  test_compare( CL_nth(tail, -1), testdata[num_testdata - 1] );
+
+  ret = 1;
+
+ test_error:
+  CL_free(list);
+  CL_free(tail);
+  CL_free(empty);
+  return ret;
+}
+
+
+/*
+ * Tests the CL_splice function
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_splice()
+{
+  int ret = 0;
+  CList dst = CL_new();
+  CList src = CL_new();
+  const char *dst_data[] = {"A", "B", "C"};
+  const char *src_data[] = {"V", "W", "X", "Y", "Z"};
+
+  for (int i=0; i < 3; i++)
+    CL_append(dst, dst_data[i]);
+  for (int i=0; i < 5; i++)
+    CL_append(src, src_data[i]);
+
+  // Out of range
+  test_assert( !CL_splice(dst, 4, src, 0, 1) );
+  test_assert( !CL_splice(dst, 0, src, 5, 1) );
+  test_assert( !CL_splice(dst, 0, src, 3, 3) );
+  test_assert( !CL_splice(dst, 0, src, -6, 1) );
+  test_assert( CL_length(dst) == 3 && CL_length(src) == 5 );
+
+  test_assert( CL_splice(dst, 1, src, 2, 2) );
+  test_assert( CL_length(dst) == 5 );
+  test_assert( CL_length(src) == 3 );
+  test_compare( CL_nth(dst, 0), "A" );
+  test_compare( CL_nth(dst, 1), "X" );
+  test_compare( CL_nth(dst, 2), "Y" );
+  test_compare( CL_nth(dst, 3), "B" );
+  test_compare( CL_nth(src, 2), "Z" );
+
+  // Negative positions: last of src onto the end of dst, then the
+  // head of dst onto the head of src
+  test_assert( CL_splice(dst, -1, src, -1, 1) );
+  test_compare( CL_nth(dst, -1), "Z" );
+  test_assert( CL_splice(src, 0, dst, 0, 1) );
+  test_compare( CL_nth(src, 0), "A" );
+  test_assert( CL_length(dst) == 5 && CL_length(src) == 3 );
+
+  // Everything, and nothing
+  test_assert( CL_splice(dst, 2, src, 0, 3) );
+  test_assert( CL_splice(dst, 0, src, 0, 0) );
+  test_assert( CL_length(dst) == 8 && CL_length(src) == 0 );
+  test_compare( CL_nth(dst, 2), "A" );
+  test_compare( CL_nth(dst, 4), "W" );
+  test_compare( CL_nth(dst, 5), "B" );
 
-  num_tests = 9;
+  ret = 1;
+
+ test_error:
+  CL_free(dst);
+  CL_free(src);
+  return ret;
+}
+
+
+// Appends each element of a slice to the list passed as cb_data
+static void append_element(int pos, const char *element, void *cb_data)
+{
+  (void) pos;
+  CL_append((CList) cb_data, element);
+}
+
+
+/*
+ * Tests the CL_slice functions
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_slice()
+{
+  int ret = 0;
+  CList list = CL_new();
+  CList copy = NULL;
+  CList visited = CL_new();
+  CListSlice slice;
+
+  slice = CL_slice(list, 0, 1);
+  test_assert( CL_slice_length(slice) == 0 );
+  test_invalid( CL_slice_nth(slice, 0) );
+
+  for (int i=0; i < num_testdata; i++)
+    CL_append(list, testdata[i]);
+
+  test_assert( CL_slice_length(CL_slice(list, 20, 2)) == 0 );
+  test_assert( CL_slice_length(CL_slice(list, -22, 1)) == 0 );
+
+  slice = CL_slice(list, -6, 4);
+  test_assert( CL_slice_length(slice) == 4 );
+  test_compare( CL_slice_nth(slice, 0), testdata[15] );
+  test_compare( CL_slice_nth(slice, -1), testdata[18] );
+  test_invalid( CL_slice_nth(slice, 4) );
+  test_invalid( CL_slice_nth(slice, -5) );
+
+  CL_slice_foreach(slice, append_element, visited);
+  copy = CL_slice_copy(slice);
+  test_assert( CL_length(visited) == 4 );
+  test_assert( CL_length(copy) == 4 );
+  for (int i=0; i < 4; i++) {
+    test_compare( CL_nth(visited, i), testdata[15 + i] );
+    test_compare( CL_nth(copy, i), testdata[15 + i] );
+  }
+
+  // Views see changes to the list's elements outside the range
+  CL_insert(list, "alpha", 16);
+  test_compare( CL_slice_nth(slice, 1), "alpha" );
+  test_assert( CL_length(list) == num_testdata + 1 );
+
+  ret = 1;
+
+ test_error:
+  CL_free(list);
+  CL_free(copy);
+  CL_free(visited);
+  return ret;
+}
+
+
+
+// Checks that a foreach function visits testdata in order
+static void check_testdata(int pos, const char *element, void *cb_data)
+{
+  if (strcmp(element, testdata[pos]) != 0)
+    *(int *) cb_data = 0;
+}
+
+// Checks that CL_foreach_z visits testdata in order
+static void check_testdata_z(size_t pos, const char *element, void *cb_data)
+{
+  if (strcmp(element, testdata[pos]) != 0)
+    *(int *) cb_data = 0;
+}
+
+
+/*
+ * Tests the size_t/ptrdiff_t variants of the positional functions
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_z_api()
+{
+  int ret = 0;
+  int matched = 1;
+  CList list = CL_new();
+
+  test_assert( CL_length_z(list) == 0 );
+  test_invalid( CL_nth_z(list, 0) );
+  test_invalid( CL_nth_z(list, -1) );
+  test_invalid( CL_remove_z(list, 0) );
+  test_assert( !CL_insert_z(list, testdata[0], 1) );
+  test_assert( !CL_insert_z(list, testdata[0], -2) );
+
+  for (ptrdiff_t i=0; i < num_testdata; i++)
+    test_assert( CL_insert_z(list, testdata[i], i) );
+  test_assert( CL_length_z(list) == (size_t) num_testdata );
+  test_assert( CL_length(list) == num_testdata );
+
+  for (ptrdiff_t i=0; i < num_testdata; i++) {
+    test_compare( CL_nth_z(list, i), testdata[i] );
+    test_compare( CL_nth_z(list, i - num_testdata), testdata[i] );
+  }
+  test_invalid( CL_nth_z(list, num_testdata) );
+  test_invalid( CL_nth_z(list, -num_testdata - 1) );
+
+  CL_foreach_z(list, check_testdata_z, &matched);
+  test_assert( matched );
+
+  test_compare( CL_remove_z(list, -1), testdata[num_testdata - 1] );
+  test_compare( CL_remove_z(list, 0), testdata[0] );
+  test_invalid( CL_remove_z(list, num_testdata - 2) );
+  test_assert( CL_insert_z(list, "alpha", -1) );
+  test_compare( CL_nth_z(list, -1), "alpha" );
+  test_assert( CL_length_z(list) == (size_t) num_testdata - 1 );
+
+  ret = 1;
+
+ test_error:
+  CL_free(list);
+  return ret;
+}
+
+
+
+/*
+ * Tests the CListCompact functions that mirror CL_push, CL_pop,
+ * CL_append, CL_nth, CL_insert and CL_remove
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_clc_basic()
+{
+  int ret = 0;
+  CListCompact list = CLC_new();
+
+  test_assert( CLC_length(list) == 0 );
+  test_invalid( CLC_pop(list) );
+  test_invalid( CLC_nth(list, 0) );
+  test_invalid( CLC_nth(list, -1) );
+  test_invalid( CLC_remove(list, 0) );
+
+  // Enough elements to grow the node arrays a few times
+  for (int i=0; i < num_testdata; i++) {
+    CLC_append(list, testdata[i]);
+    CLC_push(list, testdata[i]);
+  }
+  test_assert( CLC_length(list) == 2 * num_testdata );
+  for (int i=0; i < num_testdata; i++) {
+    test_compare( CLC_nth(list, i), testdata[num_testdata - 1 - i] );
+    test_compare( CLC_nth(list, num_testdata + i), testdata[i] );
+  }
+  test_compare( CLC_nth(list, -1), testdata[num_testdata - 1] );
+  test_invalid( CLC_nth(list, 2 * num_testdata) );
+  test_invalid( CLC_nth(list, -2 * num_testdata - 1) );
+
+  // Drain the pushed half, then reuse the freed slots
+  for (int i=num_testdata - 1; i >= 0; i--)
+    test_compare( CLC_pop(list), testdata[i] );
+  test_assert( CLC_insert(list, "alpha", 0) );
+  test_assert( CLC_insert(list, "bravo", -1) );
+  test_assert( CLC_insert(list, "charlie", 5) );
+  test_assert( !CLC_insert(list, "delta", num_testdata + 4) );
+  test_assert( !CLC_insert(list, "delta", -num_testdata - 5) );
+  test_assert( CLC_length(list) == num_testdata + 3 );
+  test_compare( CLC_nth(list, 0), "alpha" );
+  test_compare( CLC_nth(list, 5), "charlie" );
+  test_compare( CLC_nth(list, -1), "bravo" );
+
+  test_compare( CLC_remove(list, -1), "bravo" );
+  test_compare( CLC_remove(list, 5), "charlie" );
+  test_compare( CLC_remove(list, 0), "alpha" );
+  test_invalid( CLC_remove(list, num_testdata) );
+  CLC_append(list, "echo");
+  test_compare( CLC_nth(list, -1), "echo" );
+  test_assert( CLC_length(list) == num_testdata + 1 );
+
+  ret = 1;
+
+ test_error:
+  CLC_free(list);
+  return ret;
+}
+
+
+/*
+ * Tests the CListCompact functions that mirror CL_copy,
+ * CL_insert_sorted, CL_join, CL_reverse and CL_foreach
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_clc_whole_list()
+{
+  int ret = 0;
+  int matched = 1;
+  CList source = CL_new();
+  CListCompact sorted = CLC_new();
+  CListCompact list = NULL;
+  CListCompact copy = NULL;
+
+  for (int i=0; i < num_testdata; i++) {
+    CL_append(source, testdata[i]);
+    CLC_insert_sorted(sorted, testdata[i]);
+  }
+  for (int i=0; i < num_testdata; i++)
+    test_compare( CLC_nth(sorted, i), testdata_sorted[i] );
+
+  list = CLC_from_list(source);
+  test_assert( CLC_length(list) == num_testdata );
+  CLC_foreach(list, check_testdata, &matched);
+  test_assert( matched );
+
+  copy = CLC_copy(list);
+  CLC_reverse(copy);
+  test_assert( CLC_length(copy) == num_testdata );
+  test_compare( CLC_nth(copy, 0), testdata[num_testdata - 1] );
+  test_compare( CLC_nth(copy, -1), testdata[0] );
+  test_compare( CLC_nth(list, 0), testdata[0] );
+
+  // Appending after reversing uses the new tail
+  CLC_append(copy, "alpha");
+  test_compare( CLC_nth(copy, -2), testdata[0] );
+
+  CLC_join(list, copy);
+  test_assert( CLC_length(list) == 2 * num_testdata + 1 );
+  test_assert( CLC_length(copy) == 0 );
+  test_compare( CLC_nth(list, num_testdata), testdata[num_testdata - 1] );
+  test_compare( CLC_nth(list, -1), "alpha" );
+  CLC_push(copy, "bravo");
+  test_assert( CLC_length(copy) == 1 );
+
+  ret = 1;
+
+ test_error:
+  CL_free(source);
+  CLC_free(sorted);
+  CLC_free(list);
+  CLC_free(copy);
+  return ret;
+}
+
+
+
+/*
+ * Tests the CL_compact and CL_fragmentation functions, including
+ * freeing compacted nodes after they have moved to other lists
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_copy_parallel()
+{
+  int ret = 0;
+  const int n = 100000;  // Over CL_COPY_PARALLEL_MIN
+  CList list = CL_new();
+  CList joined = CL_new();
+  CList copy = NULL;
+  CList copy2 = NULL;
+  CList other = CL_new();
+
+  // A list joined from five, copied by three threads
+  for (int part=0; part < 5; part++) {
+    for (int i=n * part / 5; i < n * (part + 1) / 5; i++)
+      CL_append(joined, testdata[i % num_testdata]);
+    CL_join(list, joined);
+  }
+
+  copy = CL_copy_parallel(list, 3);
+  test_assert( CL_length(copy) == n );
+  test_assert( CL_fragmentation(copy) < 0.001 );  // Far only between parts
+  for (int i=0; i < n; i++)
+    test_compare( CL_nth(copy, i), testdata[i % num_testdata] );
+  CL_append(copy, "alpha");
+  test_compare( CL_nth(copy, -1), "alpha" );
+  test_assert( CL_length(list) == n );
+
+  // Single-threaded and short copies
+  copy2 = CL_copy_parallel(list, 1);
+  test_assert( CL_length(copy2) == n );
+  CL_free(copy2);
+  copy2 = CL_copy_parallel(joined, 4);
+  test_assert( CL_length(copy2) == 0 );
+  CL_free(copy2);
+  copy2 = NULL;
+
+  // A list never joined to is split too: one block per thread
+  for (int i=0; i < n; i++)
+    CL_append(joined, testdata[i % num_testdata]);
+  copy2 = CL_copy_parallel(joined, 1);
+  test_assert( CL_fragmentation(copy2) == 0.0 );
+  CL_free(copy2);
+  copy2 = CL_copy_parallel(joined, 3);
+  test_assert( CL_length(copy2) == n );
+  test_assert( CL_fragmentation(copy2) == 2.0 / (n - 1) );
+  for (int i=0; i < n; i++)
+    test_compare( CL_nth(copy2, i), testdata[i % num_testdata] );
+  CL_free(copy2);
+  copy2 = NULL;
+  CL_free(joined);
+  joined = CL_new();
+
+  // Cached keys are copied along
+  CL_sort(list);
+  CL_set_key(list, CL_strcmp, CL_key_prefix);
+  copy2 = CL_copy_parallel(list, 8);
+  test_assert( CL_find_sorted(copy2, "Zero") >= 0 );
+  test_assert( CL_find_sorted(copy2, "alpha") < 0 );
+  CL_insert_sorted(copy2, "alpha");
+  test_compare( CL_nth(copy2, -1), "alpha" );
+
+  // Nodes of a copy outlive it on another list, while the reclaimer
+  // frees the rest
+  test_assert( CL_splice(other, 0, copy, n / 3 - 5, 10) );
+  CL_free_deferred(copy);
+  copy = NULL;
+  CL_free_deferred(NULL);
+  CL_free_deferred(copy2);
+  copy2 = NULL;
+  for (int i=0; i < 10; i++)
+    test_compare( CL_nth(other, i), testdata[(n / 3 - 5 + i) % num_testdata] );
+  while (CL_length(other) > 0)
+    CL_pop(other);
+  CL_free_wait();
+  CL_free_wait();
+
+  ret = 1;
+
+ test_error:
+  CL_free(list);
+  CL_free(joined);
+  CL_free(copy);
+  CL_free(copy2);
+  CL_free(other);
+  return ret;
+}
+
+
+
+int test_cl_compact()
+{
+  int ret = 0;
+  CList list = CL_new();
+  CList other = CL_new();
+  CList tail = NULL;
+
+  CL_compact(list);
+  test_assert( CL_length(list) == 0 );
+  test_assert( CL_fragmentation(list) == 0.0 );
+
+  // Scatter the nodes by sorting
+  for (int i=0; i < num_testdata; i++)
+    CL_append(list, testdata[i]);
+  CL_sort(list);
+  test_assert( CL_fragmentation(list) > 0.0 );
+
+  CL_compact(list);
+  test_assert( CL_fragmentation(list) == 0.0 );
+  test_assert( CL_length(list) == num_testdata );
+  for (int i=0; i < num_testdata; i++)
+    test_compare( CL_nth(list, i), testdata_sorted[i] );
+
+  // Compacted nodes are removed, moved between lists and compacted
+  // again
+  test_compare( CL_pop(list), testdata_sorted[0] );
+  test_compare( CL_remove(list, 5), testdata_sorted[6] );
+  test_assert( CL_insert(list, "alpha", 5) );
+  test_assert( CL_splice(other, 0, list, 10, 4) );
+  tail = CL_split(list, 12);
+  CL_compact(other);
+  CL_join(other, list);
+  CL_compact(tail);
+  CL_merge_sorted(tail, other);
+  test_assert( CL_length(list) == 0 );
+  test_assert( CL_length(other) == 0 );
+  test_assert( CL_length(tail) == num_testdata - 1 );
+  CL_compact(tail);
+  while (CL_length(tail) > 1)
+    CL_pop(tail);
+
+  // Many compacted lists joined into one, their blocks emptied in
+  // turn, and nodes allocated where emptied blocks were
+  while (CL_length(tail) > 0)
+    CL_pop(tail);
+  for (int i=0; i < 200; i++) {
+    for (int j=0; j < 3; j++)
+      CL_append(other, testdata[(i + j) % num_testdata]);
+    CL_compact(other);
+    CL_join(tail, other);
+  }
+  test_assert( CL_length(tail) == 600 );
+  for (int i=0; i < 300; i++) {
+    test_compare( CL_pop(tail), testdata[(i / 3 + i % 3) % num_testdata] );
+    CL_append(tail, "beta");
+  }
+  CL_compact(tail);
+  test_assert( CL_length(tail) == 600 );
+  test_compare( CL_nth(tail, 299), testdata[(199 + 2) % num_testdata] );
+  test_compare( CL_nth(tail, 300), "beta" );
+
+  ret = 1;
+
+ test_error:
+  CL_free(list);
+  CL_free(other);
+  CL_free(tail);
+  return ret;
+}
+
+
+/*
+ * Tests automatic compaction through CL_set_auto_compact
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_auto_compact()
+{
+  int ret = 0;
+  CList list = CL_new();
+
+  // Sorting scatters the nodes; the mutations below trigger a check
+  for (int i=0; i < 1000; i++)
+    CL_push(list, testdata[i % num_testdata]);
+  CL_sort(list);
+  test_assert( CL_fragmentation(list) > 0.5 );
+
+  CL_set_auto_compact(list, 0.5);
+  for (int i=0; i < 1024; i++) {
+    CL_push(list, testdata[i % num_testdata]);
+    CL_pop(list);
+  }
+  test_assert( CL_fragmentation(list) < 0.5 );
+  test_assert( CL_length(list) == 1000 );
+  test_compare( CL_nth(list, 0), testdata_sorted[0] );
+
+  // Compacting from inside CL_append or CL_pop keeps the tail known,
+  // and the appends after it land at the end
+  CL_free(list);
+  list = CL_new();
+  for (int i=0; i < 1000; i++)
+    CL_push(list, testdata[i % num_testdata]);
+  CL_sort(list);
+  CL_set_auto_compact(list, 0.2);
+  for (int i=0; i < 1100; i++) {
+    CL_append(list, testdata[i % num_testdata]);
+    test_assert( CL_knows_tail(list) );
+    CL_pop(list);
+    test_assert( CL_knows_tail(list) );
+  }
+  test_assert( CL_fragmentation(list) < 0.2 );
+  test_assert( CL_length(list) == 1000 );
+  for (int i=0; i < 1000; i++)
+    test_compare( CL_nth(list, i), testdata[(100 + i) % num_testdata] );
+
+  ret = 1;
+
+ test_error:
+  CL_free(list);
+  return ret;
+}
+
+
+
+// Sign of a comparison result
+static int sign(int x)
+{
+  return (x > 0) - (x < 0);
+}
+
+// qsort comparator for an array of strings
+static int compare_strings(const void *a, const void *b)
+{
+  return strcmp(*(const char **) a, *(const char **) b);
+}
+
+
+/*
+ * Tests that CL_strcmp agrees with strcmp, including on strings that
+ * end right before an unmapped page
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_strcmp()
+{
+  int ret = 0;
+  char a[200], b[200];
+  long page = 4096;
+  char *pages = mmap(NULL, 2 * page, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  test_assert( pages != MAP_FAILED );
+  test_assert( mprotect(pages + page, page, PROT_NONE) == 0 );
+
+  test_assert( CL_strcmp("", "") == 0 );
+  test_assert( CL_strcmp("", "a") < 0 );
+  test_assert( CL_strcmp("a", "") > 0 );
+  test_assert( CL_strcmp("\xff", "a") > 0 );  // Bytes compare unsigned
+
+  // Every combination of length and position of the first difference
+  for (int len = 0; len < 100; len++) {
+    for (int i = 0; i < len; i++)
+      a[i] = 'a' + i % 26;
+    a[len] = '\0';
+    for (int diff = 0; diff <= len; diff++) {
+      strcpy(b, a);
+      b[diff] = (diff < len) ? a[diff] + 1 : 'x';
+      b[diff + 1] = '\0';
+      test_assert( sign(CL_strcmp(a, b)) == sign(strcmp(a, b)) );
+      test_assert( sign(CL_strcmp(b, a)) == sign(strcmp(b, a)) );
+      test_assert( CL_strcmp(a, a) == 0 );
+    }
+  }
+
+  // Strings ending at every offset before the protected page
+  for (int len = 0; len < 70; len++) {
+    char *end = pages + page - 1;
+    char *s = end - len;
+    memset(s, 'q', len);
+    *end = '\0';
+    test_assert( CL_strcmp(s, s) == 0 );
+    test_assert( sign(CL_strcmp(s, "qqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqq"))
+                 == sign(strcmp(s, "qqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqqq")) );
+  }
+
+  ret = 1;
+
+ test_error:
+  if (pages != MAP_FAILED)
+    munmap(pages, 2 * page);
+  return ret;
+}
+
+
+/*
+ * Tests sorted operations on strings with long common prefixes, with
+ * prefix keys cached
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_sorted_prefix()
+{
+  int ret = 0;
+  CList list = CL_new();
+  char urls[64][64];
+  const char *sorted[64];
+
+  for (int i=0; i < 64; i++) {
+    sprintf(urls[i], "https://www.example.com/%s/%d", testdata[i % num_testdata],
+            (i * 37) % 64);
+    sorted[i] = urls[i];
+  }
+  strcpy(urls[0], "https");  // Shorter than a key
+  strcpy(urls[1], "https:");
+  strcpy(urls[2], "");       // Sorts before every other key
+  qsort(sorted, 64, sizeof(sorted[0]), compare_strings);
+
+  CL_set_key(list, strcmp, CL_key_prefix);
+  for (int i=0; i < 32; i++)
+    CL_insert_sorted(list, urls[i]);
+  for (int i=32; i < 64; i++)
+    CL_push(list, urls[i]);
+  CL_sort(list);
+
+  test_assert( CL_length(list) == 64 );
+  for (int i=0; i < 64; i++) {
+    test_compare( CL_nth(list, i), sorted[i] );
+    test_assert( CL_find_sorted(list, sorted[i]) == i );
+  }
+  test_assert( CL_find_sorted(list, "https://www.example.com/") == -1 );
+  test_assert( CL_key_prefix("") == 0 );
+  test_assert( CL_key_prefix_nocase("") == 0 );
+  test_assert( CL_key_prefix("a") == (uint64_t) 'a' << 56 );
+  test_assert( CL_key_prefix_nocase("ABCDEFGHI") == CL_key_prefix("abcdefgh") );
+
+  ret = 1;
+
+ test_error:
+  CL_free(list);
+  return ret;
+}
+
+
+// Progress of check_batch through a list
+struct batch_check {
+  int seen;     // elements visited so far
+  int ok;       // cleared on the first mismatch
+};
+
+// Checks that each batch holds the next elements of a list made by
+// appending testdata over and over
+static void check_batch(int pos, const CListElementType *elements, int count,
+    void *cb_data)
+{
+  struct batch_check *check = (struct batch_check *) cb_data;
+
+  if (pos != check->seen || count < 1 || count > CL_FOREACH_BATCH)
+    check->ok = 0;
+  for (int i=0; i < count; i++)
+    if (strcmp(elements[i], testdata[(pos + i) % num_testdata]) != 0)
+      check->ok = 0;
+  check->seen += count;
+}
+
+
+/*
+ * Tests the CL_foreach_batch function and the CL_FOR_EACH macro
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_foreach_batch()
+{
+  int ret = 0;
+  CList list = CL_new();
+  CListElementType elem = NULL;
+  struct batch_check check = {0, 1};
+  int seen = 0;
+
+  CL_foreach_batch(list, check_batch, &check);
+  test_assert( check.seen == 0 );
+  CL_FOR_EACH(list, elem)
+    seen++;
+  test_assert( seen == 0 );
+
+  // Several full batches and a partial one
+  for (int i=0; i < 3 * CL_FOREACH_BATCH + 5; i++)
+    CL_append(list, testdata[i % num_testdata]);
+  CL_foreach_batch(list, check_batch, &check);
+  test_assert( check.ok );
+  test_assert( check.seen == CL_length(list) );
+
+  CL_FOR_EACH(list, elem) {
+    test_compare( elem, testdata[seen % num_testdata] );
+    seen++;
+  }
+  test_assert( seen == CL_length(list) );
+
+  // break and continue work as in any loop
+  seen = 0;
+  CL_FOR_EACH(list, elem) {
+    if (seen++ == 0)
+      continue;
+    if (strcmp(elem, testdata[3]) == 0)
+      break;
+  }
+  test_assert( seen == 4 );
+  test_compare( elem, testdata[3] );
+
+  ret = 1;
+
+ test_error:
+  CL_free(list);
+  return ret;
+}
+
+
+/*
+ * Tests CL_join of many lists, and operations on a list whose joined
+ * segments have not been linked yet
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_join_segments()
+{
+  int ret = 0;
+  CList list = CL_new();
+  CList part = CL_new();
+  CList copy = NULL;
+  struct batch_check check = {0, 1};
+  CListElementType elem = NULL;
+  int pos;
+
+  // testdata, joined in pieces of 1 to 4 elements
+  for (pos = 0; pos < num_testdata; ) {
+    for (int i = 0; i < 1 + pos % 4 && pos < num_testdata; i++)
+      CL_append(part, testdata[pos++]);
+    CL_join(list, part);
+    test_assert( CL_length(part) == 0 );
+  }
+  CL_join(list, part);
+  test_assert( CL_length(list) == num_testdata );
+
+  // Reads work across the segments
+  for (pos = 0; pos < num_testdata; pos++)
+    test_compare( CL_nth(list, pos), testdata[pos] );
+  test_compare( CL_nth(list, -1), testdata[num_testdata - 1] );
+  test_invalid( CL_nth(list, num_testdata) );
+  CL_foreach_batch(list, check_batch, &check);
+  test_assert( check.ok && check.seen == num_testdata );
+  copy = CL_copy(list);
+  test_compare( CL_nth(copy, num_testdata - 1), testdata[num_testdata - 1] );
+
+  // Pop the first segment empty, then add to both ends
+  test_compare( CL_pop(list), testdata[0] );
+  test_compare( CL_pop(list), testdata[1] );
+  CL_append(list, "Last");
+  CL_push(list, testdata[1]);
+  test_compare( CL_nth(list, 0), testdata[1] );
+  test_compare( CL_nth(list, 1), testdata[2] );
+  test_compare( CL_nth(list, -1), "Last" );
+  test_assert( CL_length(list) == num_testdata );
+
+  // Joining a list that has segments of its own
+  CL_join(copy, list);
+  test_assert( CL_length(copy) == 2 * num_testdata );
+  test_compare( CL_nth(copy, num_testdata), testdata[1] );
+
+  // A mutation links the segments
+  test_assert( CL_insert(copy, "Middle", num_testdata) );
+  test_compare( CL_nth(copy, num_testdata - 1), testdata[num_testdata - 1] );
+  test_compare( CL_nth(copy, num_testdata), "Middle" );
+  pos = 0;
+  CL_FOR_EACH(copy, elem)
+    pos++;
+  test_assert( pos == 2 * num_testdata + 1 );
+  test_compare( elem, "Last" );
+
+  // Joining onto a list whose end is not known, and a first chain
+  // popped empty and pushed onto again before the link
+  CL_free(list);
+  list = CL_new();
+  for (pos = 0; pos < 10; pos++)
+    CL_append(list, testdata_sorted[9 - pos]);
+  CL_sort(list);
+  test_assert( !CL_knows_tail(list) );
+  CL_append(part, "Last");
+  CL_join(list, part);
+  CL_append(part, "After");
+  CL_join(list, part);
+  for (pos = 0; pos < 10; pos++)
+    test_compare( CL_pop(list), testdata_sorted[pos] );
+  CL_push(list, "First");
+  test_assert( CL_insert(list, "Second", 1) );
+  test_assert( CL_length(list) == 4 );
+  test_compare( CL_nth(list, 0), "First" );
+  test_compare( CL_nth(list, 1), "Second" );
+  test_compare( CL_nth(list, 2), "Last" );
+  test_compare( CL_nth(list, 3), "After" );
+
+  ret = 1;
+
+ test_error:
+  CL_free(list);
+  CL_free(part);
+  CL_free(copy);
+  return ret;
+}
+
+
+/*
+ * Tests that positional access through the list's finger stays
+ * correct as the list is changed around it
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cl_finger()
+{
+  int ret = 0;
+  CList list = CL_new();
+  int pos;
+
+  // Build the list by inserting at increasing positions
+  for (pos = 0; pos < num_testdata; pos++)
+    test_assert( CL_insert(list, testdata[pos], pos) );
+  test_assert( CL_length(list) == num_testdata );
+
+  // Forwards, backwards, and repeated positions
+  for (pos = 0; pos < num_testdata; pos++)
+    test_compare( CL_nth(list, pos), testdata[pos] );
+  for (pos = num_testdata - 1; pos >= 0; pos--)
+    test_compare( CL_nth(list, pos), testdata[pos] );
+  test_compare( CL_nth(list, 3), testdata[3] );
+  test_compare( CL_nth(list, 3), testdata[3] );
+
+  // Changes at the head move the finger's position
+  test_compare( CL_nth(list, 2), testdata[2] );
+  CL_push(list, "First");
+  test_compare( CL_nth(list, 3), testdata[2] );
+  test_compare( CL_pop(list), "First" );
+  test_compare( CL_nth(list, 2), testdata[2] );
+  test_compare( CL_pop(list), testdata[0] );
+  test_compare( CL_nth(list, 0), testdata[1] );
+  test_compare( CL_pop(list), testdata[1] );  // Pops the finger's node
+  test_compare( CL_nth(list, 0), testdata[2] );
+  CL_push(list, testdata[1]);
+  CL_push(list, testdata[0]);
+
+  // Changes before and at the finger
+  test_compare( CL_nth(list, 4), testdata[4] );
+  test_assert( CL_insert(list, "Early", 1) );
+  test_compare( CL_nth(list, 5), testdata[4] );
+  test_compare( CL_remove(list, 1), "Early" );
+  test_compare( CL_nth(list, 4), testdata[4] );
+  test_compare( CL_remove(list, 4), testdata[4] );
+  test_compare( CL_nth(list, 4), testdata[5] );
+  test_assert( CL_insert(list, testdata[4], 4) );
+  test_compare( CL_remove(list, 0), testdata[0] );
+  test_assert( CL_insert(list, testdata[0], 0) );
+  test_assert( CL_insert_sorted(list, "Aardvark") == 0 );
+  test_compare( CL_nth(list, 1), testdata[0] );
+  test_compare( CL_pop(list), "Aardvark" );
+  for (pos = 0; pos < num_testdata; pos++)
+    test_compare( CL_nth(list, pos), testdata[pos] );
+
+  // Remove every other element walking forwards
+  for (pos = 0; pos < CL_length(list); pos++)
+    CL_remove(list, pos);
+  test_assert( CL_length(list) == num_testdata / 2 );
+  for (pos = 0; pos < CL_length(list); pos++)
+    test_compare( CL_nth(list, pos), testdata[2 * pos + 1] );
+
+  // Functions that reorder or free nodes forget the finger
+  test_compare( CL_nth(list, -1), testdata[num_testdata - 2] );
+  CL_reverse(list);
+  test_compare( CL_nth(list, -1), testdata[1] );
+  CL_sort(list);
+  CL_compact(list);
+  for (pos = 1; pos < CL_length(list); pos++)
+    test_assert( strcmp(CL_nth(list, pos - 1), CL_nth(list, pos)) <= 0 );
+  CL_unique(list);
+  test_assert( CL_length(list) == num_testdata / 2 );
+
+  test_invalid( CL_nth(list, num_testdata) );
+  test_assert( !CL_insert(list, "Nowhere", num_testdata) );
+  test_invalid( CL_remove(list, num_testdata) );
+
+  // Popping the finger's node keeps the tail, so a queue used after
+  // CL_nth still appends in constant time
+  while (CL_length(list) > 0)
+    CL_pop(list);
+  for (pos = 0; pos < num_testdata; pos++)
+    CL_append(list, testdata[pos]);
+  test_compare( CL_nth(list, 1), testdata[1] );
+  for (pos = 0; pos < 3 * num_testdata; pos++) {
+    test_compare( CL_pop(list), testdata[pos % num_testdata] );
+    test_assert( CL_knows_tail(list) );
+    CL_append(list, testdata[pos % num_testdata]);
+  }
+  for (pos = 0; pos < num_testdata; pos++)
+    test_compare( CL_nth(list, pos), testdata[pos] );
+
+  ret = 1;
+
+ test_error:
+  CL_free(list);
+  return ret;
+}
+
+
+/*
+ * Tests the ring list functions
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_clr()
+{
+  int ret = 0;
+  CListRing ring = CLR_new(3, CLR_REJECT);
+  CListRing window = CLR_new(4, CLR_OVERWRITE);
+  CList list = CL_new();
+
+  test_assert( CLR_length(ring) == 0 );
+  test_assert( CLR_capacity(ring) == 3 );
+  test_invalid( CLR_pop(ring) );
+  test_invalid( CLR_nth(ring, 0) );
+  test_invalid( CLR_nth(ring, -1) );
+
+  test_assert( CLR_append(ring, "B") );
+  test_assert( CLR_push(ring, "A") );
+  test_assert( CLR_append(ring, "C") );
+  test_assert( !CLR_append(ring, "D") );
+  test_assert( !CLR_push(ring, "D") );
+  test_assert( CLR_length(ring) == 3 );
+  test_compare( CLR_nth(ring, 0), "A" );
+  test_compare( CLR_nth(ring, 2), "C" );
+  test_compare( CLR_nth(ring, -1), "C" );
+  test_compare( CLR_nth(ring, -3), "A" );
+  test_invalid( CLR_nth(ring, 3) );
+  test_invalid( CLR_nth(ring, -4) );
+
+  // Wrap around the end of the array
+  test_compare( CLR_pop(ring), "A" );
+  test_assert( CLR_append(ring, "D") );
+  test_compare( CLR_pop(ring), "B" );
+  test_assert( CLR_append(ring, "E") );
+  test_compare( CLR_nth(ring, 0), "C" );
+  test_compare( CLR_nth(ring, 1), "D" );
+  test_compare( CLR_nth(ring, 2), "E" );
+
+  // A sliding window keeps the newest elements
+  for (int i=0; i < 10; i++)
+    test_assert( CLR_append(window, testdata[i]) );
+  test_assert( CLR_length(window) == 4 );
+  test_compare( CLR_nth(window, 0), testdata[6] );
+  test_compare( CLR_nth(window, -1), testdata[9] );
+  CLR_foreach(window, append_element, list);
+  test_assert( CL_length(list) == 4 );
+  test_compare( CL_nth(list, 0), testdata[6] );
+  test_compare( CL_nth(list, 3), testdata[9] );
+
+  // Pushing onto a full window drops its last element instead
+  test_assert( CLR_push(window, testdata[0]) );
+  test_compare( CLR_nth(window, 0), testdata[0] );
+  test_compare( CLR_nth(window, 1), testdata[6] );
+  test_compare( CLR_nth(window, -1), testdata[8] );
+  while (CLR_length(window) > 0)
+    CLR_pop(window);
+  test_invalid( CLR_pop(window) );
+
+  ret = 1;
+
+ test_error:
+  CLR_free(ring);
+  CLR_free(window);
+  CL_free(list);
+  return ret;
+}
+
+
+
+// True if the queue's file descriptor is readable
+static bool queue_fd_ready(CListQueue queue)
+{
+  struct pollfd pfd = {CLQ_fd(queue), POLLIN, 0};
+  return poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLIN);
+}
+
+// Thread appending testdata to a queue, one element at a time
+static void *queue_producer(void *arg)
+{
+  CListQueue queue = (CListQueue) arg;
+
+  for (int i = 0; i < num_testdata; i++) {
+    if (i % 4 == 0)
+      usleep(1000);  // Let the consumer block now and then
+    CLQ_append(queue, testdata[i]);
+  }
+  return NULL;
+}
+
+
+/*
+ * Tests the producer-consumer queue functions
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_clq()
+{
+  int ret = 0;
+  CListQueue queue = CLQ_new();
+  CList list = CL_new();
+  pthread_t producer;
+  bool started = false;
+
+  test_assert( CLQ_length(queue) == 0 );
+  test_invalid( CLQ_pop(queue) );
+  test_invalid( CLQ_pop_wait(queue, 10) );  // Times out
+  test_assert( !queue_fd_ready(queue) );
+
+  test_assert( CLQ_append(queue, "Alpha") );
+  test_assert( queue_fd_ready(queue) );
+  test_assert( CLQ_append(queue, "Bravo") );
+  test_compare( CLQ_pop(queue), "Alpha" );
+  test_assert( queue_fd_ready(queue) );
+  test_compare( CLQ_pop_wait(queue, 0), "Bravo" );
+  test_assert( !queue_fd_ready(queue) );
+
+  // A batch, after a single element
+  for (int i = 1; i < num_testdata; i++)
+    CL_append(list, testdata[i]);
+  test_assert( CLQ_append(queue, testdata[0]) );
+  test_assert( CLQ_append_all(queue, list) );
+  test_assert( CL_length(list) == 0 );
+  test_assert( CLQ_append_all(queue, list) );
+  test_assert( CLQ_length(queue) == num_testdata );
+  for (int i = 0; i < num_testdata; i++) {
+    test_assert( queue_fd_ready(queue) );
+    test_compare( CLQ_pop(queue), testdata[i] );
+  }
+  test_assert( !queue_fd_ready(queue) );
+
+  // Another thread wakes this one
+  test_assert( pthread_create(&producer, NULL, queue_producer, queue) == 0 );
+  started = true;
+  for (int i = 0; i < num_testdata; i++)
+    test_compare( CLQ_pop_wait(queue, -1), testdata[i] );
+  pthread_join(producer, NULL);
+  started = false;
+  test_assert( CLQ_length(queue) == 0 );
+
+  // Closing keeps what is queued, and stops waits and appends
+  test_assert( CLQ_append(queue, "Last") );
+  CLQ_close(queue);
+  test_assert( CLQ_is_closed(queue) );
+  test_assert( !CLQ_append(queue, "Late") );
+  CL_append(list, "Late");
+  test_assert( !CLQ_append_all(queue, list) );
+  test_assert( CL_length(list) == 1 );
+  test_compare( CLQ_pop_wait(queue, -1), "Last" );
+  test_invalid( CLQ_pop_wait(queue, -1) );
+  test_assert( queue_fd_ready(queue) );
+
+  ret = 1;
+
+ test_error:
+  if (started)
+    pthread_join(producer, NULL);
+  CLQ_free(queue);
+  CL_free(list);
+  return ret;
+}
+
+
+#ifdef CL_TRACE
+// Counts the elements of a traced CL_foreach
+static void trace_count(int pos, CListElementType element, void *cb_data)
+{
+  (void) pos;
+  (void) element;
+  (*(int *) cb_data)++;
+}
+#endif
+
+// Thread recording 100 trace events for the list at arg
+static void *trace_recorder(void *arg)
+{
+  for (int i = 0; i < 100; i++)
+    CLT_record(CLT_OP_NTH, (uintptr_t) arg, i, i, CLT_now());
+  return NULL;
+}
+
+
+/*
+ * Tests the tracing event rings and histograms
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_clt()
+{
+  int ret = 0;
+  int max = 2 * CLT_RING_SIZE;
+  CLTEvent *events = (CLTEvent *) malloc(max * sizeof(CLTEvent));
+  CLTEvent *loaded = NULL;
+  char *text = NULL;
+  size_t text_size;
+  char path[] = "/tmp/clist_test_traceXXXXXX";
+  int fd = -1;
+  pthread_t recorder;
+  int count;
+
+  CLT_reset();
+  test_assert( CLT_collect(events, max) == 0 );
+
+  uint64_t start = CLT_now();
+  CLT_record(CLT_OP_INSERT, 42, 7, 3, start);
+  CLT_record(CLT_OP_SORT, 42, -1, 21, start);
+  test_assert( CLT_collect(events, max) == 2 );
+  test_assert( events[0].op == CLT_OP_INSERT );
+  test_assert( events[0].list_id == 42 );
+  test_assert( events[0].pos == 7 );
+  test_assert( events[0].walked == 3 );
+  test_assert( events[0].start_ns == start );
+  test_assert( events[0].duration_ns <= CLT_now() - start );
+  test_assert( events[1].op == CLT_OP_SORT );
+  test_assert( events[1].pos == -1 );
+  test_assert( events[1].thread == events[0].thread );
+  test_assert( CLT_collect(events, 1) == 1 );
+  test_assert( strcmp(CLT_op_name(CLT_OP_SORT), "sort") == 0 );
+  test_assert( strcmp(CLT_op_name(CLT_OP_DIFFERENCE_SORTED),
+                      "difference_sorted") == 0 );
+
+  // A full ring keeps the newest events
+  CLT_reset();
+  for (int i = 0; i < CLT_RING_SIZE + 10; i++)
+    CLT_record(CLT_OP_NTH, 1, i, 0, CLT_now());
+  test_assert( CLT_collect(events, max) == CLT_RING_SIZE );
+  test_assert( events[0].pos == 10 );
+  test_assert( events[CLT_RING_SIZE - 1].pos == CLT_RING_SIZE + 9 );
+
+  // Another thread records into a ring of its own
+  CLT_reset();
+  CLT_record(CLT_OP_REMOVE, 1, 0, 0, CLT_now());
+  test_assert( pthread_create(&recorder, NULL, trace_recorder, events) == 0 );
+  pthread_join(recorder, NULL);
+  count = CLT_collect(events, max);
+  test_assert( count == 101 );
+  int others = 0;
+  for (int i = 0; i < count; i++) {
+    if (events[i].op != CLT_OP_NTH) continue;
+    test_assert( events[i].list_id == (uintptr_t) events );
+    test_assert( events[i].thread != 0 );
+    others++;
+  }
+  test_assert( others == 100 );
+
+  // The histograms
+  FILE *out = open_memstream(&text, &text_size);
+  test_assert( out );
+  CLT_print_histogram(out, events, count);
+  fclose(out);
+  test_assert( strstr(text, "nth: 100 events") != NULL );
+  test_assert( strstr(text, "remove: 1 events") != NULL );
+  test_assert( strstr(text, "walked avg 49.5, max 99") != NULL );
+  test_assert( strstr(text, "insert") == NULL );
+
+  // Saved and loaded
+  fd = mkstemp(path);
+  test_assert( fd >= 0 );
+  test_assert( CLT_save(path) );
+  loaded = CLT_load(path, &count);
+  test_assert( loaded != NULL );
+  test_assert( count == 101 );
+  test_assert( memcmp(loaded, events, count * sizeof(CLTEvent)) == 0 );
+  test_assert( CLT_load("/dev/null", &count) == NULL );
+
+#ifdef CL_TRACE
+  // The hooks in clist.c
+  CList list = CL_new();
+  CList other = CL_new();
+  int counted = 0;
+  for (int i = 0; i < num_testdata; i++)
+    CL_push(list, testdata[i]);
+  CLT_reset();
+  CL_nth(list, 5);
+  CL_nth(list, 9);
+  CL_remove(list, 2);
+  CL_join(list, other);
+  CL_foreach(list, trace_count, &counted);
+  CL_free(other);
+  CL_free(list);
+  test_assert( counted == num_testdata - 1 );
+  test_assert( CLT_collect(events, max) == 7 );
+  test_assert( events[0].op == CLT_OP_NTH && events[0].walked == 5 );
+  test_assert( events[1].op == CLT_OP_NTH && events[1].walked == 4 );
+  test_assert( events[2].op == CLT_OP_REMOVE && events[2].walked == 2 );
+  test_assert( events[2].list_id == (uintptr_t) list );
+  test_assert( events[3].op == CLT_OP_JOIN && events[3].walked == 0 );
+  test_assert( events[4].op == CLT_OP_FOREACH
+               && events[4].walked == (uint64_t) num_testdata - 1 );
+  test_assert( events[5].op == CLT_OP_FREE && events[5].walked == 0 );
+  test_assert( events[6].op == CLT_OP_FREE
+               && events[6].list_id == (uintptr_t) list );
+#endif
+
+  ret = 1;
+
+ test_error:
+  if (fd >= 0) {
+    close(fd);
+    unlink(path);
+  }
+  free(text);
+  free(loaded);
+  free(events);
+  return ret;
+}
+
+
+// Callback for CLRCU_foreach: removes the element after the current
+// one, and checks that the current one is still readable
+static void rcu_remove_next(int pos, CListElementType element, void *cb_data)
+{
+  CListRCU list = (CListRCU) cb_data;
+  if (pos == 1) {
+    CLRCU_remove(list, 1);  // The node the walk is on
+    CLRCU_reclaim(list);
+  }
+  assert(strlen(element) > 0);
+}
+
+// Callback for CLRCU_foreach: counts the elements seen, and how many
+// were "Anchor"
+static void rcu_count(int pos, CListElementType element, void *cb_data)
+{
+  (void) pos;
+  int *counts = (int *) cb_data;
+  counts[0]++;
+  if (strcmp(element, "Anchor") == 0)
+    counts[1]++;
+}
+
+// Thread changing an RCU list at both ends and in the middle, while
+// "Anchor" stays in it
+static void *rcu_writer(void *arg)
+{
+  CListRCU list = (CListRCU) arg;
+
+  for (int round = 0; round < 200; round++) {
+    for (int i = 0; i < num_testdata; i++) {
+      if (i % 2)
+        CLRCU_push(list, testdata[i]);
+      else
+        CLRCU_append(list, testdata[i]);
+    }
+    for (int i = 0; i < num_testdata; i++) {
+      if (i % 2)
+        CLRCU_pop(list);
+      else
+        CLRCU_remove(list, -1);
+    }
+  }
+  return NULL;
+}
+
+
+/*
+ * Tests the RCU list functions
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_clrcu()
+{
+  int ret = 0;
+  CListRCU list = CLRCU_new();
+  CList copy = NULL;
+  pthread_t writer;
+  bool started = false;
+
+  test_assert( CLRCU_length(list) == 0 );
+  test_invalid( CLRCU_pop(list) );
+  test_invalid( CLRCU_remove(list, 0) );
+  test_invalid( CLRCU_nth(list, 0) );
+  test_assert( !CLRCU_insert(list, "Bad", 1) );
+
+  for (int i = 0; i < num_testdata; i++)
+    CLRCU_append(list, testdata[i]);
+  test_assert( CLRCU_length(list) == num_testdata );
+  for (int i = 0; i < num_testdata; i++)
+    test_compare( CLRCU_nth(list, i), testdata[i] );
+  test_compare( CLRCU_nth(list, -1), testdata[num_testdata - 1] );
+  test_invalid( CLRCU_nth(list, num_testdata) );
+
+  test_compare( CLRCU_pop(list), "Zero" );
+  CLRCU_push(list, "Zero");
+  test_assert( CLRCU_insert(list, "Middle", 3) );
+  test_compare( CLRCU_nth(list, 3), "Middle" );
+  test_compare( CLRCU_remove(list, 3), "Middle" );
+  test_compare( CLRCU_remove(list, -1), "Twenty" );
+  CLRCU_append(list, "Twenty");  // After removing the last node
+  test_assert( CLRCU_insert(list, "End", -1) );
+  test_compare( CLRCU_remove(list, -1), "End" );
+  test_compare( CLRCU_nth(list, -1), "Twenty" );
+
+  copy = CLRCU_copy(list);
+  test_assert( CL_length(copy) == num_testdata );
+  for (int i = 0; i < num_testdata; i++)
+    test_compare( CL_nth(copy, i), testdata[i] );
+
+  // A node removed under a reader is retired, not freed, until the
+  // reader is done with it
+  CLRCU_reclaim(list);
+  test_assert( CLRCU_pending(list) == 0 );
+  CLRCU_foreach(list, rcu_remove_next, list);
+  test_assert( CLRCU_pending(list) == 1 );
+  CLRCU_reclaim(list);
+  test_assert( CLRCU_pending(list) == 0 );
+  test_assert( CLRCU_length(list) == num_testdata - 1 );
+  test_compare( CLRCU_nth(list, 1), "Two" );
+
+  // Readers walk the list while another thread changes it
+  while (CLRCU_pop(list) != INVALID_RETURN)
+    ;
+  CLRCU_push(list, "Anchor");
+  test_assert( pthread_create(&writer, NULL, rcu_writer, list) == 0 );
+  started = true;
+  for (int scan = 0; scan < 2000; scan++) {
+    int counts[2] = {0, 0};
+    CLRCU_foreach(list, rcu_count, counts);
+    test_assert( counts[1] == 1 );
+    test_assert( counts[0] <= 2 * num_testdata + 1 );
+  }
+  pthread_join(writer, NULL);
+  started = false;
+  test_assert( CLRCU_length(list) == 1 );
+  test_compare( CLRCU_nth(list, 0), "Anchor" );
+
+  ret = 1;
+
+ test_error:
+  if (started)
+    pthread_join(writer, NULL);
+  CL_free(copy);
+  CLRCU_free(list);
+  return ret;
+}
+
+
+// Elements appended to a sharded list by each of shard_appender's
+// threads
+#define SHARD_APPENDS 2000
+
+// Thread appending "<thread>:<n>" for n in [0, SHARD_APPENDS) to a
+// sharded list, in order
+struct shard_appender {
+  CListShards shards;
+  char names[SHARD_APPENDS][16];
+  int thread;
+};
+
+static void *shard_append(void *arg)
+{
+  struct shard_appender *a = (struct shard_appender *) arg;
+  for (int i = 0; i < SHARD_APPENDS; i++) {
+    snprintf(a->names[i], sizeof(a->names[i]), "%d:%05d", a->thread, i);
+    CLS_append(a->shards, a->names[i]);
+  }
+  return NULL;
+}
+
+
+/*
+ * Tests the sharded list functions
+ *
+ * Returns: 1 if all tests pass, 0 otherwise
+ */
+int test_cls()
+{
+  int ret = 0;
+  CListShards shards = CLS_new(3);
+  CList list = NULL;
+  struct shard_appender *appenders = NULL;
+  pthread_t threads[4];
+  int started = 0;
+
+  test_assert( CLS_num_shards(shards) == 3 );
+  test_assert( CLS_length(shards) == 0 );
+  list = CLS_collect(shards);
+  test_assert( CL_length(list) == 0 );
+  CL_free(list);
+
+  // Shard by shard, in order within each
+  for (int i = 0; i < num_testdata; i++)
+    CLS_append_to(shards, i % 3, testdata[i]);
+  test_assert( CLS_length(shards) == num_testdata );
+  list = CLS_collect(shards);
+  test_assert( CLS_length(shards) == 0 );
+  test_assert( CL_length(list) == num_testdata );
+  int pos = 0;
+  for (int shard = 0; shard < 3; shard++)
+    for (int i = shard; i < num_testdata; i += 3)
+      test_compare( CL_nth(list, pos++), testdata[i] );
+  CL_append(list, "Appended");
+  test_compare( CL_nth(list, -1), "Appended" );
+  CL_free(list);
+
+  // Sorted
+  for (int i = 0; i < num_testdata; i++)
+    CLS_append_to(shards, i % 3, testdata[i]);
+  list = CLS_collect_sorted(shards);
+  test_assert( CL_length(list) == num_testdata );
+  for (int i = 0; i < num_testdata; i++)
+    test_compare( CL_nth(list, i), testdata_sorted[i] );
+  CL_free(list);
+  for (int i = 0; i < num_testdata; i++)
+    CLS_append_to(shards, i % 3, testdata[i]);
+  list = CLS_collect_sorted_cmp(shards, strcasecmp);
+  for (int i = 0; i < num_testdata; i++)
+    test_compare( CL_nth(list, i), testdata_sorted[i] );
+  CL_free(list);
+  list = NULL;
+
+  // Threads appending at once, more of them than shards; each
+  // thread's elements stay in order
+  appenders = (struct shard_appender *) malloc(4 * sizeof(*appenders));
+  for (int t = 0; t < 4; t++) {
+    appenders[t].shards = shards;
+    appenders[t].thread = t;
+    test_assert( pthread_create(&threads[t], NULL, shard_append,
+                                &appenders[t]) == 0 );
+    started++;
+  }
+  while (started > 0)
+    pthread_join(threads[--started], NULL);
+  test_assert( CLS_length(shards) == 4 * SHARD_APPENDS );
+  list = CLS_collect(shards);
+  test_assert( CL_length(list) == 4 * SHARD_APPENDS );
+  int next[4] = {0, 0, 0, 0};
+  CListElementType elem;
+  CL_FOR_EACH(list, elem) {
+    int t = elem[0] - '0';
+    test_assert( t >= 0 && t < 4 );
+    test_assert( atoi(elem + 2) == next[t] );
+    next[t]++;
+  }
+
+  ret = 1;
+
+ test_error:
+  while (started > 0)
+    pthread_join(threads[--started], NULL);
+  CL_free(list);
+  CLS_free(shards);
+  free(appenders);
+  return ret;
+}
+
+
+
+int main() {
+  int passed = 0;
+  int num_tests = 0;
+
+  passed += run_test(test_cl_push_pop, "test_cl_push_pop");
+  passed += run_test(test_cl_append, "test_cl_append");
+  passed += run_test(test_cl_nth, "test_cl_nth");
+  passed += run_test(sample_clist_usage, "sample_clist_usage");
+  passed += run_test(test_CL_insert, "test_CL_insert");
+  passed += run_test(test_CL_remove, "test_CL_remove");
+  passed += run_test(test_CL_copy, "test_CL_copy");
+  passed += run_test(test_CL_reverse, "test_CL_reverse");
+  passed += run_test(test_CL_foreach, "test_CL_foreach");
+  passed += run_test(test_cl_insert_sorted, "test_cl_insert_sorted");
+  passed += run_test(test_cl_sort, "test_cl_sort");
+  passed += run_test(test_cl_sort_radix, "test_cl_sort_radix");
+  passed += run_test(test_cl_sorted_cmp, "test_cl_sorted_cmp");
+  passed += run_test(test_cl_merge_sorted, "test_cl_merge_sorted");
+  passed += run_test(test_cl_set_ops, "test_cl_set_ops");
+  passed += run_test(test_cl_merge_sorted_k, "test_cl_merge_sorted_k");
+  passed += run_test(test_cl_unique, "test_cl_unique");
+  passed += run_test(test_cl_remove_if, "test_cl_remove_if");
+  passed += run_test(test_pq, "test_pq");
+  passed += run_test(test_clr, "test_clr");
+  passed += run_test(test_clq, "test_clq");
+  passed += run_test(test_clt, "test_clt");
+  passed += run_test(test_clrcu, "test_clrcu");
+  passed += run_test(test_cls, "test_cls");
+  passed += run_test(test_cl_foreach_batch, "test_cl_foreach_batch");
+  passed += run_test(test_cl_join_segments, "test_cl_join_segments");
+  passed += run_test(test_cl_finger, "test_cl_finger");
+  passed += run_test(test_cl_split, "test_cl_split");
+  passed += run_test(test_cl_splice, "test_cl_splice");
+  passed += run_test(test_cl_slice, "test_cl_slice");
+  passed += run_test(test_cl_z_api, "test_cl_z_api");
+  passed += run_test(test_clc_basic, "test_clc_basic");
+  passed += run_test(test_clc_whole_list, "test_clc_whole_list");
+  passed += run_test(test_cl_compact, "test_cl_compact");
+  passed += run_test(test_cl_copy_parallel, "test_cl_copy_parallel");
+  passed += run_test(test_cl_auto_compact, "test_cl_auto_compact");
+  passed += run_test(test_cl_strcmp, "test_cl_strcmp");
+  passed += run_test(test_cl_sorted_prefix, "test_cl_sorted_prefix");
+
+  num_tests = 38;
 
   printf("Passed %d/%d test cases\n", passed, num_tests);
   fflush(stdout);
@@ -0,0 +1,402 @@
+/*
+ * clist_trace.c
+ *
+ * Per-thread event rings for tracing CList operations, and the
+ * latency histograms printed from them
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include <stdatomic.h>
+
+#include "clist_trace.h"
+
+static_assert((CLT_RING_SIZE & (CLT_RING_SIZE - 1)) == 0,
+              "CLT_RING_SIZE must be a power of two");
+
+// Fields of an event, as stored in a slot
+enum { CLT_START, CLT_DURATION, CLT_LIST, CLT_POS, CLT_WALKED, CLT_OP_THREAD,
+       CLT_NUM_FIELDS };
+
+// A slot of a ring. The fields are atomic so that a reader may copy
+// them while the owning thread overwrites them; relaxed atomic loads
+// and stores of 64 bits are plain moves on the usual targets.
+struct _clt_slot {
+  atomic_uint_fast64_t seq;     // number of the event held, plus one;
+                                // 0 while it is being written
+  _Atomic uint64_t fields[CLT_NUM_FIELDS];
+};
+
+// A thread's ring. Only the owning thread writes the slots and head.
+struct _clt_ring {
+  atomic_uint_fast64_t head;    // events ever recorded in the ring
+  atomic_uint_fast64_t floor;   // events before this were reset
+  uint32_t thread;
+  struct _clt_ring *next;       // the ring of the previous thread
+  struct _clt_slot slots[CLT_RING_SIZE];
+};
+
+// Every thread's ring, most recent thread first. Rings are never
+// freed, so that events of threads that have exited can still be read.
+static _Atomic(struct _clt_ring *) _CLT_rings = NULL;
+static atomic_uint _CLT_num_threads = 0;
+
+static _Thread_local struct _clt_ring *_CLT_ring = NULL;
+
+// Magic number at the start of a file written by CLT_save
+static const char _CLT_magic[8] = "CLTRACE1";
+
+static const char *_CLT_op_names[CLT_NUM_OPS] = {
+  "nth", "insert", "remove", "append", "insert_sorted", "find_sorted",
+  "sort", "sort_radix", "merge_sorted", "unique", "remove_if", "copy",
+  "split", "splice", "compact", "push", "pop", "free", "reverse", "dedup",
+  "join", "foreach", "foreach_z", "foreach_batch", "intersect_sorted",
+  "difference_sorted"
+};
+
+
+
+/*
+ * Return the calling thread's ring, creating and publishing it on the
+ * thread's first event
+ *
+ * Returns: The ring
+ */
+static struct _clt_ring *
+_CLT_my_ring()
+{
+  struct _clt_ring *ring = _CLT_ring;
+  if (ring != NULL) return ring;
+
+  ring = (struct _clt_ring *) calloc(1, sizeof(struct _clt_ring));
+  assert(ring);
+  ring->thread = atomic_fetch_add(&_CLT_num_threads, 1) + 1;
+
+  ring->next = atomic_load(&_CLT_rings);
+  while (!atomic_compare_exchange_weak(&_CLT_rings, &ring->next, ring))
+    ;
+  _CLT_ring = ring;
+  return ring;
+}
+
+
+
+// Documented in .h file
+uint64_t CLT_now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+}
+
+
+
+// Documented in .h file
+void CLT_record(CLTOp op, uint64_t list_id, int64_t pos, uint64_t walked,
+                uint64_t start_ns)
+{
+  uint64_t now = CLT_now();
+  struct _clt_ring *ring = _CLT_my_ring();
+  uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  struct _clt_slot *slot = &ring->slots[head & (CLT_RING_SIZE - 1)];
+
+  // A reader that sees seq unchanged around its copy of the fields
+  // knows that none of them was written meanwhile
+  atomic_store_explicit(&slot->seq, 0, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+
+  uint64_t fields[CLT_NUM_FIELDS] = {
+    [CLT_START] = start_ns,
+    [CLT_DURATION] = now - start_ns,
+    [CLT_LIST] = list_id,
+    [CLT_POS] = (uint64_t) pos,
+    [CLT_WALKED] = walked,
+    [CLT_OP_THREAD] = (uint64_t) op << 32 | ring->thread,
+  };
+  for (int i = 0; i < CLT_NUM_FIELDS; i++)
+    atomic_store_explicit(&slot->fields[i], fields[i], memory_order_relaxed);
+
+  atomic_store_explicit(&slot->seq, head + 1, memory_order_release);
+  atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+
+
+/*
+ * Copy the event numbered seq - 1 out of a slot, unless it has been
+ * overwritten, or is being
+ *
+ * Parameters:
+ *   slot     The slot
+ *   seq      The event's number, plus one
+ *   event    Where to store the event
+ *
+ * Returns: true if the event was copied
+ */
+static bool
+_CLT_read_slot(struct _clt_slot *slot, uint64_t seq, CLTEvent *event)
+{
+  if (atomic_load_explicit(&slot->seq, memory_order_acquire) != seq)
+    return false;
+
+  uint64_t fields[CLT_NUM_FIELDS];
+  for (int i = 0; i < CLT_NUM_FIELDS; i++)
+    fields[i] = atomic_load_explicit(&slot->fields[i], memory_order_relaxed);
+  atomic_thread_fence(memory_order_acquire);
+  if (atomic_load_explicit(&slot->seq, memory_order_relaxed) != seq)
+    return false;
+
+  event->start_ns = fields[CLT_START];
+  event->duration_ns = fields[CLT_DURATION];
+  event->list_id = fields[CLT_LIST];
+  event->pos = (int64_t) fields[CLT_POS];
+  event->walked = fields[CLT_WALKED];
+  event->op = (uint32_t) (fields[CLT_OP_THREAD] >> 32);
+  event->thread = (uint32_t) fields[CLT_OP_THREAD];
+  return true;
+}
+
+
+
+// Documented in .h file
+int CLT_collect(CLTEvent events[], int max)
+{
+  assert(events || max == 0);
+
+  int count = 0;
+  struct _clt_ring *ring = atomic_load(&_CLT_rings);
+  for (; ring != NULL && count < max; ring = ring->next) {
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint64_t first = atomic_load(&ring->floor);
+    if (head - first > CLT_RING_SIZE)
+      first = head - CLT_RING_SIZE;
+
+    for (uint64_t i = first; i < head && count < max; i++) {
+      struct _clt_slot *slot = &ring->slots[i & (CLT_RING_SIZE - 1)];
+      if (_CLT_read_slot(slot, i + 1, &events[count]))
+        count++;
+    }
+  }
+  return count;
+}
+
+
+
+// Documented in .h file
+void CLT_reset()
+{
+  struct _clt_ring *ring = atomic_load(&_CLT_rings);
+  for (; ring != NULL; ring = ring->next)
+    atomic_store(&ring->floor, atomic_load(&ring->head));
+}
+
+
+
+// Documented in .h file
+const char *CLT_op_name(CLTOp op)
+{
+  if (op >= CLT_NUM_OPS) return "unknown";
+  return _CLT_op_names[op];
+}
+
+
+
+/*
+ * Print a duration with a unit that suits its size
+ *
+ * Parameters:
+ *   out      Where to print
+ *   ns       The duration, in nanoseconds
+ *   width    The least number of characters to print the number in
+ *
+ * Returns: None
+ */
+static void
+_CLT_print_duration(FILE *out, uint64_t ns, int width)
+{
+  if (ns < 10000)
+    fprintf(out, "%*lu ns", width, (unsigned long) ns);
+  else if (ns < 1000000)
+    fprintf(out, "%*.1f us", width, ns / 1e3);
+  else
+    fprintf(out, "%*.1f ms", width, ns / 1e6);
+}
+
+
+
+// qsort comparator for durations
+static int
+_CLT_compare_u64(const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *) a;
+  uint64_t y = *(const uint64_t *) b;
+  return (x > y) - (x < y);
+}
+
+
+
+// Histogram bucket for a duration: 0 for 0 ns, else b for durations
+// in [2^(b-1), 2^b) ns
+static int
+_CLT_bucket(uint64_t ns)
+{
+  return ns == 0 ? 0 : 64 - __builtin_clzll(ns);
+}
+
+
+
+// Documented in .h file
+void CLT_print_histogram(FILE *out, const CLTEvent events[], int count)
+{
+  assert(out);
+  assert(events || count == 0);
+
+  uint64_t *durations = (uint64_t *) malloc((count + 1) * sizeof(uint64_t));
+  assert(durations);
+
+  for (int op = 0; op < CLT_NUM_OPS; op++) {
+    int n = 0;
+    uint64_t walked = 0, max_walked = 0;
+    unsigned long buckets[65] = {0};
+
+    for (int i = 0; i < count; i++) {
+      if (events[i].op != (uint32_t) op) continue;
+      durations[n++] = events[i].duration_ns;
+      buckets[_CLT_bucket(events[i].duration_ns)]++;
+      walked += events[i].walked;
+      if (events[i].walked > max_walked) max_walked = events[i].walked;
+    }
+    if (n == 0) continue;
+
+    qsort(durations, n, sizeof(uint64_t), _CLT_compare_u64);
+    fprintf(out, "%s: %d events, median ", CLT_op_name(op), n);
+    _CLT_print_duration(out, durations[n / 2], 0);
+    fprintf(out, ", p99 ");
+    _CLT_print_duration(out, durations[(int) (n * 0.99)], 0);
+    fprintf(out, ", max ");
+    _CLT_print_duration(out, durations[n - 1], 0);
+    fprintf(out, "; walked avg %.1f, max %lu\n",
+            (double) walked / n, (unsigned long) max_walked);
+
+    unsigned long most = 0;
+    int lo = 64, hi = 0;
+    for (int b = 0; b <= 64; b++) {
+      if (buckets[b] == 0) continue;
+      if (buckets[b] > most) most = buckets[b];
+      if (b < lo) lo = b;
+      hi = b;
+    }
+    for (int b = lo; b <= hi; b++) {
+      int bar = (int) ((buckets[b] * 40 + most - 1) / most);
+      fprintf(out, "  ");
+      _CLT_print_duration(out, b == 0 ? 0 : (uint64_t) 1 << (b - 1), 6);
+      fprintf(out, " .. ");
+      if (b == 64)
+        fprintf(out, "      max");
+      else
+        _CLT_print_duration(out, (uint64_t) 1 << b, 6);
+      fprintf(out, " %9lu |%.*s\n", buckets[b], bar,
+              "########################################");
+    }
+  }
+
+  free(durations);
+}
+
+
+
+/*
+ * Copy the events in every thread's ring into a malloc'd array
+ *
+ * Parameters:
+ *   count    Set to the number of events
+ *
+ * Returns: The events, which the caller must free
+ */
+static CLTEvent *
+_CLT_collect_all(int *count)
+{
+  int max = (atomic_load(&_CLT_num_threads) + 1) * CLT_RING_SIZE;
+  CLTEvent *events = (CLTEvent *) malloc(max * sizeof(CLTEvent));
+  assert(events);
+
+  // Threads that start meanwhile are missed
+  *count = CLT_collect(events, max);
+  return events;
+}
+
+
+
+// Documented in .h file
+void CLT_dump(FILE *out)
+{
+  int count;
+  CLTEvent *events = _CLT_collect_all(&count);
+  CLT_print_histogram(out, events, count);
+  free(events);
+}
+
+
+
+// Documented in .h file
+bool CLT_save(const char *path)
+{
+  assert(path);
+
+  FILE *file = fopen(path, "wb");
+  if (file == NULL) return false;
+
+  int count;
+  CLTEvent *events = _CLT_collect_all(&count);
+  uint32_t size = sizeof(CLTEvent);
+  bool ok = fwrite(_CLT_magic, sizeof(_CLT_magic), 1, file) == 1
+    && fwrite(&size, sizeof(size), 1, file) == 1
+    && fwrite(events, sizeof(CLTEvent), count, file) == (size_t) count;
+  free(events);
+
+  return fclose(file) == 0 && ok;
+}
+
+
+
+// Documented in .h file
+CLTEvent *CLT_load(const char *path, int *count)
+{
+  assert(path);
+  assert(count);
+
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) return NULL;
+
+  char magic[sizeof(_CLT_magic)];
+  uint32_t size;
+  if (fread(magic, sizeof(magic), 1, file) != 1
+      || memcmp(magic, _CLT_magic, sizeof(magic)) != 0
+      || fread(&size, sizeof(size), 1, file) != 1
+      || size != sizeof(CLTEvent)) {
+    fclose(file);
+    return NULL;
+  }
+
+  int max = 1024;
+  int n = 0;
+  CLTEvent *events = (CLTEvent *) malloc(max * sizeof(CLTEvent));
+  assert(events);
+  size_t got;
+  while ((got = fread(&events[n], sizeof(CLTEvent), max - n, file)) > 0) {
+    n += (int) got;
+    if (n == max) {
+      max *= 2;
+      events = (CLTEvent *) realloc(events, max * sizeof(CLTEvent));
+      assert(events);
+    }
+  }
+  fclose(file);
+
+  *count = n;
+  return events;
+}
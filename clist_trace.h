@@ -0,0 +1,179 @@
+/*
+ * clist_trace.h
+ *
+ * Tracing of CList operations, for finding out which operations were
+ * running, and how far they walked, when latency spikes.
+ *
+ * Build clist.c with -DCL_TRACE to record an event for each traced
+ * operation: which operation, on which list, at which position, how
+ * many nodes it walked and how long it took. Without CL_TRACE the
+ * hooks in clist.c compile to nothing and cost nothing.
+ *
+ * Each thread records into a ring buffer of its own, so recording
+ * takes no lock and never waits; once a ring is full, each new event
+ * overwrites the oldest. Any thread may read the rings meanwhile
+ * (CLT_collect, CLT_dump, CLT_save): events overwritten while being
+ * read are skipped, never returned torn.
+ *
+ * CLT_dump prints a latency histogram per operation. CLT_save writes
+ * the events to a file, which the clist_trace_dump tool reads and
+ * prints the same histograms for.
+ */
+
+#ifndef _CLIST_TRACE_H_
+#define _CLIST_TRACE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Events each thread's ring holds; a power of two
+#ifndef CLT_RING_SIZE
+#define CLT_RING_SIZE 4096
+#endif
+
+// The traced operations
+typedef enum {
+  CLT_OP_NTH,
+  CLT_OP_INSERT,
+  CLT_OP_REMOVE,
+  CLT_OP_APPEND,
+  CLT_OP_INSERT_SORTED,
+  CLT_OP_FIND_SORTED,
+  CLT_OP_SORT,
+  CLT_OP_SORT_RADIX,
+  CLT_OP_MERGE_SORTED,
+  CLT_OP_UNIQUE,
+  CLT_OP_REMOVE_IF,
+  CLT_OP_COPY,
+  CLT_OP_SPLIT,
+  CLT_OP_SPLICE,
+  CLT_OP_COMPACT,
+  CLT_OP_PUSH,
+  CLT_OP_POP,
+  CLT_OP_FREE,
+  CLT_OP_REVERSE,
+  CLT_OP_DEDUP,
+  CLT_OP_JOIN,
+  CLT_OP_FOREACH,
+  CLT_OP_FOREACH_Z,
+  CLT_OP_FOREACH_BATCH,
+  CLT_OP_INTERSECT_SORTED,
+  CLT_OP_DIFFERENCE_SORTED,
+  CLT_NUM_OPS
+} CLTOp;
+
+// One traced operation
+typedef struct {
+  uint64_t start_ns;            // when it began, on CLT_now's clock
+  uint64_t duration_ns;
+  uint64_t list_id;             // the list's address
+  int64_t pos;                  // position operated on, or -1 if none
+  uint64_t walked;              // nodes walked
+  uint32_t op;                  // a CLTOp
+  uint32_t thread;              // numbered from 1, in order of first event
+} CLTEvent;
+
+
+/*
+ * Return the current time in nanoseconds, from a monotonic clock
+ *
+ * Parameters: None
+ *
+ * Returns: The time
+ */
+uint64_t CLT_now();
+
+
+/*
+ * Record an event in the calling thread's ring. The hooks in clist.c
+ * call this; it may also be called directly, to trace other code.
+ *
+ * Parameters:
+ *   op        The operation
+ *   list_id   The list operated on
+ *   pos       The position operated on, or -1 if none
+ *   walked    Nodes walked
+ *   start_ns  When the operation began, from CLT_now; its duration
+ *             runs from then until now
+ *
+ * Returns: None
+ */
+void CLT_record(CLTOp op, uint64_t list_id, int64_t pos, uint64_t walked,
+                uint64_t start_ns);
+
+
+/*
+ * Copy the events held in every thread's ring, oldest first within
+ * each thread
+ *
+ * Parameters:
+ *   events   Where to store the events
+ *   max      The most events to store
+ *
+ * Returns: The number of events stored
+ */
+int CLT_collect(CLTEvent events[], int max);
+
+
+/*
+ * Forget every event recorded so far, in every thread
+ *
+ * Parameters: None
+ *
+ * Returns: None
+ */
+void CLT_reset();
+
+
+// Return the name of an operation, such as "nth"
+const char *CLT_op_name(CLTOp op);
+
+
+/*
+ * Print, for each operation in a set of events, the number of events,
+ * their median, 99th percentile and longest durations, the average
+ * and longest walks, and a histogram of the durations in powers of
+ * two.
+ *
+ * Parameters:
+ *   out      Where to print
+ *   events   The events
+ *   count    The number of events
+ *
+ * Returns: None
+ */
+void CLT_print_histogram(FILE *out, const CLTEvent events[], int count);
+
+
+// Print the histograms for the events in every thread's ring, as
+// CLT_collect and CLT_print_histogram
+void CLT_dump(FILE *out);
+
+
+/*
+ * Write the events in every thread's ring to a file, for the
+ * clist_trace_dump tool
+ *
+ * Parameters:
+ *   path     The file, which is created or replaced
+ *
+ * Returns: true on success, false if the file could not be written
+ */
+bool CLT_save(const char *path);
+
+
+/*
+ * Read events written by CLT_save
+ *
+ * Parameters:
+ *   path     The file
+ *   count    Set to the number of events read
+ *
+ * Returns: The events, in a malloc'd array that the caller must free,
+ *   or NULL if the file could not be read or is not a trace
+ */
+CLTEvent *CLT_load(const char *path, int *count);
+
+
+#endif /* _CLIST_TRACE_H_ */
@@ -0,0 +1,67 @@
+/*
+ * clist_trace_dump.c
+ *
+ * Prints the per-operation latency histograms for trace files
+ * written by CLT_save.
+ *
+ * Usage: ./clist_trace_dump [-l] file...
+ *
+ * With -l, each event is also listed, oldest first.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "./clist_trace.h"
+
+
+// qsort comparator ordering events by start time
+static int compare_start(const void *a, const void *b)
+{
+  uint64_t x = ((const CLTEvent *) a)->start_ns;
+  uint64_t y = ((const CLTEvent *) b)->start_ns;
+  return (x > y) - (x < y);
+}
+
+
+int main(int argc, char *argv[])
+{
+  bool list = false;
+  int first = 1;
+
+  if (argc > 1 && strcmp(argv[1], "-l") == 0) {
+    list = true;
+    first++;
+  }
+  if (first >= argc) {
+    fprintf(stderr, "Usage: %s [-l] file...\n", argv[0]);
+    return 1;
+  }
+
+  for (int i = first; i < argc; i++) {
+    int count;
+    CLTEvent *events = CLT_load(argv[i], &count);
+    if (events == NULL) {
+      fprintf(stderr, "%s: can not read trace\n", argv[i]);
+      return 1;
+    }
+
+    printf("%s: %d events\n", argv[i], count);
+    if (list) {
+      qsort(events, count, sizeof(CLTEvent), compare_start);
+      for (int j = 0; j < count; j++)
+        printf("  %14llu thread %-3u %-17s list %#llx pos %-8lld "
+               "walked %-8llu %llu ns\n",
+               (unsigned long long) events[j].start_ns, events[j].thread,
+               CLT_op_name(events[j].op),
+               (unsigned long long) events[j].list_id,
+               (long long) events[j].pos,
+               (unsigned long long) events[j].walked,
+               (unsigned long long) events[j].duration_ns);
+    }
+    CLT_print_histogram(stdout, events, count);
+    free(events);
+  }
+  return 0;
+}